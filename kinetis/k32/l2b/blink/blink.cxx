@@ -34,24 +34,19 @@
 #include "platform.hxx"
 #include "constants.hxx"
 #include "k32l2b.hxx"
+#include "clock.hxx"
+#ifdef CLOCK_STRESS
+#include "clockStress.hxx"
+#endif
 
 static void clockSetup()
 {
 	// Disable the WDT
 	sim.copCtrl = vals::sim::copCtrlDisabled;
 	// Switch into HIRC mode as we want to go LIRC 8MHz -> 2MHz and this must be done indirectly.
-	mcg.miscCtrl = vals::mcg::miscCtrlHIRClkEnabled | vals::mcg::miscCtrlLIRClkDiv1;
-	while ((mcg.status & vals::mcg::statusClkModeMask) != vals::mcg::statusClkModeHIRC)
-		mcg.ctrl1 = vals::mcg::ctrl1ClkModeHIRC | vals::mcg::ctrl1IRefClkEnabled;
+	switchToHIRC();
 	// Configure the clock as the 2MHz low-precision internal reference
-	mcg.ctrl2 = vals::mcg::ctrl2LIRC2MHz;
-	mcg.statusCtrl = vals::mcg::statusCtrlLIRClkDiv1;
-	mcg.miscCtrl = vals::mcg::miscCtrlHIRClkEnabled | vals::mcg::miscCtrlLIRClkDiv1;
-	while ((mcg.status & vals::mcg::statusClkModeMask) != vals::mcg::statusClkModeLIRC)
-		mcg.ctrl1 = vals::mcg::ctrl1ClkModeLIRC | vals::mcg::ctrl1IRefClkEnabled |
-			vals::mcg::ctrl1IRefStopEnabled;
-	// And clean up.
-	mcg.miscCtrl = vals::mcg::miscCtrlHIRClkDisabled | vals::mcg::miscCtrlLIRClkDiv1;
+	switchToLIRC(vals::mcg::ctrl2LIRC2MHz);
 	// Enable PortC clocking
 	sim.clockGateCtrl[1] |= vals::sim::clockGateCtrl1PortC;
 }
@@ -69,10 +64,14 @@ void run()
 	clockSetup();
 	gpioSetup();
 
+#ifdef CLOCK_STRESS
+	clockStress();
+#else
 	while (true) {
 		// Toggle PC1 on and off which makes the red part of the RGB LED blink.
 		fgpioC.bitToggle = 1;
 		for (volatile size_t i = 0; i < 1000000U; ++i)
 			continue;
 	}
+#endif
 }
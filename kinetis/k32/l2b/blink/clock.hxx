@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the black magic probe test firmware archive.
+ *
+ * Copyright (C) 2022 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CLOCK_HXX
+#define CLOCK_HXX
+
+#include <cstdint>
+#include "constants.hxx"
+#include "k32l2b.hxx"
+
+// Switch MCG-Lite over to running the core from the 48MHz high-frequency internal reference
+inline void switchToHIRC() noexcept
+{
+	mcg.miscCtrl = vals::mcg::miscCtrlHIRClkEnabled | vals::mcg::miscCtrlLIRClkDiv1;
+	while ((mcg.status & vals::mcg::statusClkModeMask) != vals::mcg::statusClkModeHIRC)
+		mcg.ctrl1 = vals::mcg::ctrl1ClkModeHIRC | vals::mcg::ctrl1IRefClkEnabled;
+}
+
+/*
+ * Switch MCG-Lite over to running the core from the low-frequency internal reference, at either 2MHz or 8MHz
+ * depending on `range` (vals::mcg::ctrl2LIRC2MHz or vals::mcg::ctrl2LIRC8MHz). The LIRC cannot be retuned
+ * while it is clocking the core, so this must be done from HIRC mode.
+ */
+inline void switchToLIRC(const uint8_t range) noexcept
+{
+	mcg.ctrl2 = range;
+	mcg.statusCtrl = vals::mcg::statusCtrlLIRClkDiv1;
+	mcg.miscCtrl = vals::mcg::miscCtrlHIRClkEnabled | vals::mcg::miscCtrlLIRClkDiv1;
+	while ((mcg.status & vals::mcg::statusClkModeMask) != vals::mcg::statusClkModeLIRC)
+		mcg.ctrl1 = vals::mcg::ctrl1ClkModeLIRC | vals::mcg::ctrl1IRefClkEnabled |
+			vals::mcg::ctrl1IRefStopEnabled;
+	// And clean up.
+	mcg.miscCtrl = vals::mcg::miscCtrlHIRClkDisabled | vals::mcg::miscCtrlLIRClkDiv1;
+}
+
+#endif /*CLOCK_HXX*/
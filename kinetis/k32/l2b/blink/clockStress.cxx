@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the black magic probe test firmware archive.
+ *
+ * Copyright (C) 2022 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include "clockStress.hxx"
+#include "clock.hxx"
+#include "constants.hxx"
+#include "k32l2b.hxx"
+
+#ifndef CLOCK_STRESS_DWELL
+// How long to stay in each clock mode before moving on, in milliseconds
+#define CLOCK_STRESS_DWELL 100U
+#endif
+
+struct clockStep_t final
+{
+	clockMode_t mode;
+	uint32_t frequency;
+};
+
+/*
+ * LIRC 2MHz -> LIRC 8MHz -> HIRC 48MHz and round again covers every transition between the three, as the
+ * LIRC 2MHz -> LIRC 8MHz step has to pass through HIRC to retune the LIRC. The bus and flash clock is the
+ * core clock / 2 out of reset, which keeps it within spec at 48MHz.
+ */
+constexpr static std::array<clockStep_t, 3> schedule
+{{
+	{clockMode_t::lirc2MHz, 2'000'000U},
+	{clockMode_t::lirc8MHz, 8'000'000U},
+	{clockMode_t::hirc48MHz, 48'000'000U},
+}};
+
+static_assert(schedule[2].frequency / 1000U - 1U <= vals::sysTick::reloadMask);
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+[[gnu::used]] clockStressState_t clockStressState
+{
+	clockStressMagic,
+	schedule[0].mode,
+	schedule[0].frequency,
+	0U,
+	CLOCK_STRESS_DWELL,
+};
+
+// Run SysTick from the core clock, wrapping once a millisecond at the given frequency
+static void sysTickStart(const uint32_t frequency) noexcept
+{
+	sysTick.ctrlStatus = vals::sysTick::ctrlStatusDisabled;
+	sysTick.reload = frequency / 1000U - 1U;
+	sysTick.current = 0U;
+	sysTick.ctrlStatus = vals::sysTick::ctrlStatusClkSrcCore | vals::sysTick::ctrlStatusIntDisabled |
+		vals::sysTick::ctrlStatusEnabled;
+}
+
+static void dwell() noexcept
+{
+	// Reading the control and status register clears the count flag, so each wrap is seen once
+	for (uint32_t milliseconds{0U}; milliseconds < CLOCK_STRESS_DWELL; ++milliseconds)
+	{
+		while (!(sysTick.ctrlStatus & vals::sysTick::ctrlStatusCountFlag))
+			continue;
+	}
+}
+
+static void switchTo(const clockStep_t &step) noexcept
+{
+	clockStressState.mode = clockMode_t::switching;
+	clockStressState.frequency = 0U;
+	// SysTick's timebase is meaningless while the clock is in flux
+	sysTick.ctrlStatus = vals::sysTick::ctrlStatusDisabled;
+
+	if ((mcg.status & vals::mcg::statusClkModeMask) != vals::mcg::statusClkModeHIRC)
+		switchToHIRC();
+	if (step.mode == clockMode_t::lirc2MHz)
+		switchToLIRC(vals::mcg::ctrl2LIRC2MHz);
+	else if (step.mode == clockMode_t::lirc8MHz)
+		switchToLIRC(vals::mcg::ctrl2LIRC8MHz);
+
+	sysTickStart(step.frequency);
+	clockStressState.frequency = step.frequency;
+	clockStressState.mode = step.mode;
+	clockStressState.switchCount = clockStressState.switchCount + 1U;
+}
+
+void clockStress()
+{
+	// clockSetup() leaves us running from LIRC 2MHz, which is where the schedule starts
+	size_t step{0U};
+	sysTickStart(schedule[step].frequency);
+
+	while (true)
+	{
+		dwell();
+		step = (step + 1U) % schedule.size();
+		switchTo(schedule[step]);
+		// Toggle PC1 on each switch so the red part of the RGB LED shows the schedule is running.
+		fgpioC.bitToggle = 1;
+	}
+}
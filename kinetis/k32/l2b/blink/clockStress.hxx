@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the black magic probe test firmware archive.
+ *
+ * Copyright (C) 2022 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CLOCK_STRESS_HXX
+#define CLOCK_STRESS_HXX
+
+#include <cstdint>
+
+enum class clockMode_t : uint32_t
+{
+	lirc2MHz = 0U,
+	lirc8MHz = 1U,
+	hirc48MHz = 2U,
+	// Published while MCG-Lite is part way between two modes
+	switching = 0xFFFF'FFFFU,
+};
+
+/*
+ * Published at the clockStressState symbol for the probe side to poll while it runs its throughput tests.
+ * mode and frequency describe the clock the core is running from right now, and switchCount goes up by one
+ * as each switch completes.
+ */
+struct clockStressState_t final
+{
+	uint32_t magic;
+	volatile clockMode_t mode;
+	volatile uint32_t frequency;
+	volatile uint32_t switchCount;
+	uint32_t dwellTime;
+};
+
+// 'CLKS' when read out of memory
+constexpr static uint32_t clockStressMagic{0x534B'4C43U};
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+extern "C" clockStressState_t clockStressState;
+
+[[noreturn]] void clockStress();
+
+#endif /*CLOCK_STRESS_HXX*/
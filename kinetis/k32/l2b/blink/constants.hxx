@@ -97,7 +97,7 @@ namespace vals
 		constexpr static uint8_t statusCtrlLIRClkDiv1{0x00U};
 
 		constexpr static uint8_t miscCtrlHIRClkEnabled{0x80U};
-		constexpr static uint8_t miscCtrlHIRClkDisabled{0x80U};
+		constexpr static uint8_t miscCtrlHIRClkDisabled{0x00U};
 		constexpr static uint8_t miscCtrlLIRClkDiv128{0x07U};
 		constexpr static uint8_t miscCtrlLIRClkDiv64{0x06U};
 		constexpr static uint8_t miscCtrlLIRClkDiv32{0x05U};
@@ -107,6 +107,19 @@ namespace vals
 		constexpr static uint8_t miscCtrlLIRClkDiv2{0x01U};
 		constexpr static uint8_t miscCtrlLIRClkDiv1{0x00U};
 	} // namespace mcg
+
+	namespace sysTick
+	{
+		constexpr static uint32_t ctrlStatusCountFlag{0x00010000U};
+		constexpr static uint32_t ctrlStatusClkSrcCore{0x00000004U};
+		constexpr static uint32_t ctrlStatusClkSrcExt{0x00000000U};
+		constexpr static uint32_t ctrlStatusIntEnabled{0x00000002U};
+		constexpr static uint32_t ctrlStatusIntDisabled{0x00000000U};
+		constexpr static uint32_t ctrlStatusEnabled{0x00000001U};
+		constexpr static uint32_t ctrlStatusDisabled{0x00000000U};
+
+		constexpr static uint32_t reloadMask{0x00FFFFFFU};
+	} // namespace sysTick
 } // namespace vals
 
 #endif /*CONSTANTS_HXX*/
@@ -88,6 +88,15 @@ namespace k32l2b
 	};
 	static_assert(sizeof(gpio_t) == 24U);
 
+	struct sysTick_t final
+	{
+		volatile uint32_t ctrlStatus;
+		volatile uint32_t reload;
+		volatile uint32_t current;
+		const volatile uint32_t calibration;
+	};
+	static_assert(sizeof(sysTick_t) == 16U);
+
 	constexpr static uintptr_t simBase{0x4004'7000U};
 
 	constexpr static uintptr_t mcgBase{0x4006'4000U};
@@ -103,6 +112,8 @@ namespace k32l2b
 	constexpr static uintptr_t fgpioCBase{0xF800'0080U};
 	constexpr static uintptr_t fgpioDBase{0xF800'00C0U};
 	constexpr static uintptr_t fgpioEBase{0xF800'0100U};
+
+	constexpr static uintptr_t sysTickBase{0xE000'E010U};
 } // namespace k32l2b
 
 // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
@@ -122,6 +133,8 @@ static auto &fgpioB{*reinterpret_cast<k32l2b::gpio_t *>(k32l2b::fgpioBBase)};
 static auto &fgpioC{*reinterpret_cast<k32l2b::gpio_t *>(k32l2b::fgpioCBase)};
 static auto &fgpioD{*reinterpret_cast<k32l2b::gpio_t *>(k32l2b::fgpioDBase)};
 static auto &fgpioE{*reinterpret_cast<k32l2b::gpio_t *>(k32l2b::fgpioEBase)};
+
+static auto &sysTick{*reinterpret_cast<k32l2b::sysTick_t *>(k32l2b::sysTickBase)};
 // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
 // NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
 
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "arena.hxx"
+
+// These are provided by the linker script
+/* NOLINTBEGIN(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+extern "C" const uint8_t end;
+extern "C" const uint8_t _stack;
+extern "C" const uint8_t stackReserve;
+/* NOLINTEND(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+
+namespace semihosting::memory
+{
+	Arena arena{};
+
+	[[nodiscard]] static uintptr_t alignUp(const uintptr_t value, const size_t alignment) noexcept
+		{ return (value + alignment - 1U) & ~uintptr_t(alignment - 1U); }
+
+	void Arena::reset(const uintptr_t regionBase, const uintptr_t regionLimit) noexcept
+	{
+		base = regionBase;
+		limit = regionLimit;
+		current = regionBase;
+	}
+
+	void *Arena::allocate(const size_t size, const size_t alignment) noexcept
+	{
+		const auto start{alignUp(current, alignment)};
+		if (start < current || start > limit || size > limit - start)
+			return nullptr;
+		current = start + size;
+		return reinterpret_cast<void *>(start);
+	}
+
+	size_t Arena::available(const size_t alignment) const noexcept
+	{
+		const auto start{alignUp(current, alignment)};
+		return start < limit ? limit - start : 0U;
+	}
+
+	void Arena::rewind(const uintptr_t position) noexcept
+	{
+		if (position >= base && position <= current)
+			current = position;
+	}
+
+	bool setupArena(const types::HeapInfoBlock &infoBlock) noexcept
+	{
+		// Work out the usable bounds of RAM - anything from the end of .bss up to the bottom of the stack reservation
+		const auto ramBase{reinterpret_cast<uintptr_t>(&end)};
+		const auto ramLimit{reinterpret_cast<uintptr_t>(&_stack) - reinterpret_cast<uintptr_t>(&stackReserve)};
+
+		// Clamp what the host gave us to that, if it reported anything at all
+		const auto heapBase{alignUp(infoBlock.heapBase < ramBase ? ramBase : infoBlock.heapBase,
+			alignof(std::max_align_t))};
+		const auto heapLimit{infoBlock.heapLimit > ramLimit ? ramLimit : uintptr_t{infoBlock.heapLimit}};
+		if (infoBlock.heapBase && infoBlock.heapLimit && heapBase < heapLimit)
+		{
+			arena.reset(heapBase, heapLimit);
+			return true;
+		}
+		arena.reset(alignUp(ramBase, alignof(std::max_align_t)), ramLimit);
+		return false;
+	}
+} // namespace semihosting::memory
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARENA_HXX
+#define ARENA_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <substrate/span>
+
+#include "syscallTypes.hxx"
+
+namespace semihosting::memory
+{
+	// A bump allocator over a single region of RAM. Memory is only ever given back by rewinding to a
+	// previously taken mark, which makes allocation O(1) and fragmentation impossible.
+	struct Arena final
+	{
+	private:
+		uintptr_t base{0U};
+		uintptr_t limit{0U};
+		uintptr_t current{0U};
+
+	public:
+		constexpr Arena() noexcept = default;
+		Arena(const Arena &) = delete;
+		Arena(Arena &&) = delete;
+		Arena &operator =(const Arena &) = delete;
+		Arena &operator =(Arena &&) = delete;
+
+		void reset(uintptr_t regionBase, uintptr_t regionLimit) noexcept;
+		[[nodiscard]] void *allocate(size_t size, size_t alignment = alignof(std::max_align_t)) noexcept;
+
+		// Allocate storage for `count` objects of type T, returning an empty span if there is not enough room
+		template<typename T> [[nodiscard]] substrate::span<T> allocate(const size_t count) noexcept
+		{
+			auto *const storage{static_cast<T *>(allocate(sizeof(T) * count, alignof(T)))};
+			if (!storage)
+				return {};
+			return {storage, count};
+		}
+
+		// Allocate as many objects of type T as will fit, up to maxCount
+		template<typename T> [[nodiscard]] substrate::span<T> allocateUpTo(const size_t maxCount) noexcept
+		{
+			const auto count{available(alignof(T)) / sizeof(T)};
+			return allocate<T>(count < maxCount ? count : maxCount);
+		}
+
+		[[nodiscard]] size_t available(size_t alignment = alignof(std::max_align_t)) const noexcept;
+		[[nodiscard]] size_t size() const noexcept { return limit - base; }
+		[[nodiscard]] uintptr_t regionBase() const noexcept { return base; }
+		[[nodiscard]] uintptr_t regionLimit() const noexcept { return limit; }
+		[[nodiscard]] uintptr_t mark() const noexcept { return current; }
+		void rewind(uintptr_t position) noexcept;
+	};
+
+	// Takes a mark on construction and rewinds the arena back to it on destruction, freeing
+	// everything allocated in the scope in one go
+	struct ArenaScope final
+	{
+	private:
+		Arena &_arena;
+		uintptr_t _mark;
+
+	public:
+		ArenaScope(Arena &arena) noexcept : _arena{arena}, _mark{arena.mark()} { }
+		ArenaScope(const ArenaScope &) = delete;
+		ArenaScope(ArenaScope &&) = delete;
+		~ArenaScope() noexcept { _arena.rewind(_mark); }
+		ArenaScope &operator =(const ArenaScope &) = delete;
+		ArenaScope &operator =(ArenaScope &&) = delete;
+	};
+
+	extern Arena arena;
+
+	// Set the arena up over the heap region reported by the host, falling back to the RAM between the end of
+	// .bss and the stack reservation when the host reports no (usable) heap. Returns true if the host's region was used.
+	bool setupArena(const types::HeapInfoBlock &infoBlock) noexcept;
+} // namespace semihosting::memory
+
+#endif /*ARENA_HXX*/
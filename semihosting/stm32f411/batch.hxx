@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BATCH_HXX
+#define BATCH_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+#include <substrate/span>
+
+#include "syscalls.hxx"
+#include "syscallTypes.hxx"
+
+namespace semihosting
+{
+	/*
+	 * Builds a descriptor list for runBatch() with storage for up to N operations and their parameter blocks.
+	 * Each operation added returns its index, which later operations taking an FD use to name the operation
+	 * (normally an open) whose result is that FD. Once full, further operations are refused and run() fails.
+	 */
+	template<size_t N> struct Batch final
+	{
+	private:
+		std::array<types::BatchOperation, N> _operations{};
+		std::array<std::array<uintptr_t, 4>, N> _params{};
+		size_t _count{0U};
+		bool _overflowed{false};
+
+		size_t add(const types::Syscall syscall, const int32_t resultFrom,
+			const std::array<uintptr_t, 4> &params) noexcept
+		{
+			if (_count == N)
+			{
+				_overflowed = true;
+				return N;
+			}
+			_params[_count] = params;
+			_operations[_count] = {syscall, _params[_count].data(), resultFrom, -1, types::FileIOErrno::success};
+			return _count++;
+		}
+
+	public:
+		size_t open(const std::string_view &path, const types::OpenMode mode) noexcept
+		{
+			return add(types::Syscall::open, -1,
+				{{reinterpret_cast<uintptr_t>(path.data()), static_cast<uintptr_t>(mode), path.length()}});
+		}
+
+		size_t close(const size_t fdFrom) noexcept
+			{ return add(types::Syscall::close, static_cast<int32_t>(fdFrom), {}); }
+
+		size_t write(const size_t fdFrom, const substrate::span<const uint8_t> &data) noexcept
+		{
+			return add(types::Syscall::write, static_cast<int32_t>(fdFrom),
+				{{0U, reinterpret_cast<uintptr_t>(data.data()), data.size_bytes()}});
+		}
+
+		size_t read(const size_t fdFrom, const substrate::span<uint8_t> &data) noexcept
+		{
+			return add(types::Syscall::read, static_cast<int32_t>(fdFrom),
+				{{0U, reinterpret_cast<uintptr_t>(data.data()), data.size_bytes()}});
+		}
+
+		size_t seek(const size_t fdFrom, const uint32_t offset) noexcept
+			{ return add(types::Syscall::seek, static_cast<int32_t>(fdFrom), {{0U, offset}}); }
+
+		size_t remove(const std::string_view &path) noexcept
+			{ return add(types::Syscall::remove, -1, {{reinterpret_cast<uintptr_t>(path.data()), path.length()}}); }
+
+		// Run everything added so far, returning true only if every operation ran and none returned -1
+		[[nodiscard]] bool run() noexcept
+		{
+			if (_overflowed)
+				return false;
+			const auto ran{runBatch({_operations.data(), _count})};
+			return ran == _count && (!_count || _operations[_count - 1U].result != -1);
+		}
+
+		void clear() noexcept
+		{
+			_count = 0U;
+			_overflowed = false;
+		}
+
+		[[nodiscard]] size_t size() const noexcept { return _count; }
+		[[nodiscard]] int32_t result(const size_t index) const noexcept { return _operations[index].result; }
+		[[nodiscard]] types::FileIOErrno error(const size_t index) const noexcept { return _operations[index].error; }
+	};
+} // namespace semihosting
+
+#endif /*BATCH_HXX*/
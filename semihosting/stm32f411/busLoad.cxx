@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <array>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+#include "busLoad.hxx"
+#include "hostConsole.hxx"
+#include "ramfunc.hxx"
+#include "wallClock.hxx"
+
+using namespace std::literals::string_view_literals;
+
+namespace semihosting::busLoad
+{
+	using host::console::host;
+
+	// Only DMA2 can do memory-to-memory transfers, and of its streams, 0 and 1 are free in this firmware
+	constexpr static auto loadDMA{DMA2};
+	constexpr static std::array<uint8_t, 2U> loadStreams{DMA_STREAM0, DMA_STREAM1};
+	constexpr static std::array<uint8_t, 2U> loadIRQs{NVIC_DMA2_STREAM0_IRQ, NVIC_DMA2_STREAM1_IRQ};
+	// Where each stream's flags sit in DMA_LISR/DMA_LIFCR, and the mask of all 5 of them
+	constexpr static std::array<uint8_t, 2U> flagShifts{0U, 6U};
+	constexpr static uint32_t allFlags{DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 |
+		DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0};
+	// How many bytes each stream copies per block before it has to be rearmed
+	constexpr static size_t blockSize{4096U};
+	// The FIFO is 16 bytes and memory-to-memory transfers must go through it, so a burst must fit in it exactly
+	constexpr static size_t fifoSize{16U};
+
+	// The streams all copy from the same source, but each to its own destination
+	alignas(fifoSize) static std::array<uint8_t, blockSize> source{};
+	alignas(fifoSize) static std::array<std::array<uint8_t, blockSize>, loadStreams.size()> destinations{};
+
+	static Config currentConfig{Priority::low, 1U};
+	// The stream control value to rearm with, less the enable bit, or 0 if the load is not running
+	static uint32_t control{0U};
+	// How many data items make up a block at the configured transfer size
+	static uint32_t items{0U};
+	// Written only by the interrupt handlers
+	static volatile uint32_t blocks{0U};
+	static volatile uint32_t errors{0U};
+
+	// Pick the transfer size that makes `burst` beats exactly fill the FIFO, encoded as for PSIZE/MSIZE
+	[[nodiscard]] static bool burstEncoding(const uint8_t burst, uint32_t &burstBits, uint32_t &sizeBits) noexcept
+	{
+		switch (burst)
+		{
+			case 1U:
+				// Single transfers can be any size, so use words as they move the most per bus access
+				burstBits = 0U;
+				sizeBits = 2U;
+				return true;
+			case 4U:
+				burstBits = 1U;
+				sizeBits = 2U;
+				return true;
+			case 8U:
+				burstBits = 2U;
+				sizeBits = 1U;
+				return true;
+			case 16U:
+				burstBits = 3U;
+				sizeBits = 0U;
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	static void clearFlags(const size_t stream) noexcept
+		{ DMA_LIFCR(loadDMA) = allFlags << flagShifts[stream]; }
+
+	[[RAMFUNC]] static void arm(const size_t stream) noexcept
+	{
+		const auto number{loadStreams[stream]};
+		DMA_SNDTR(loadDMA, number) = items;
+		DMA_SCR(loadDMA, number) = control | DMA_SxCR_EN;
+	}
+
+	bool start(const Config &config) noexcept
+	{
+		uint32_t burstBits{};
+		uint32_t sizeBits{};
+		if (!burstEncoding(config.burst, burstBits, sizeBits) || config.priority > Priority::veryHigh)
+			return false;
+		stop();
+
+		RCC_AHB1ENR = RCC_AHB1ENR | RCC_AHB1ENR_DMA2EN;
+		currentConfig = config;
+		items = blockSize >> sizeBits;
+		// In memory-to-memory mode the peripheral side of the stream is the source
+		control = DMA_SxCR_DIR_MEM_TO_MEM | DMA_SxCR_PINC | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE |
+			(static_cast<uint32_t>(config.priority) << DMA_SxCR_PL_SHIFT) |
+			(sizeBits << DMA_SxCR_PSIZE_SHIFT) | (sizeBits << DMA_SxCR_MSIZE_SHIFT) |
+			(burstBits << DMA_SxCR_PBURST_SHIFT) | (burstBits << DMA_SxCR_MBURST_SHIFT);
+		for (size_t stream{0U}; stream < loadStreams.size(); ++stream)
+		{
+			const auto number{loadStreams[stream]};
+			DMA_SPAR(loadDMA, number) = source.data();
+			DMA_SM0AR(loadDMA, number) = destinations[stream].data();
+			DMA_SFCR(loadDMA, number) = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_4_4_FULL;
+			clearFlags(stream);
+			// Rearming is the only work these interrupts do, so keep them out of the way of anything else
+			nvic_set_priority(loadIRQs[stream], 0xf0U);
+			nvic_enable_irq(loadIRQs[stream]);
+		}
+		for (size_t stream{0U}; stream < loadStreams.size(); ++stream)
+			arm(stream);
+		return true;
+	}
+
+	void stop() noexcept
+	{
+		if (!control)
+			return;
+		// Stop the handlers rearming the streams before turning them off
+		control = 0U;
+		for (size_t stream{0U}; stream < loadStreams.size(); ++stream)
+		{
+			const auto number{loadStreams[stream]};
+			nvic_disable_irq(loadIRQs[stream]);
+			DMA_SCR(loadDMA, number) = 0U;
+			// The stream finishes the burst it is in the middle of before it actually stops
+			while (DMA_SCR(loadDMA, number) & DMA_SxCR_EN)
+				continue;
+			clearFlags(stream);
+			nvic_clear_pending_irq(loadIRQs[stream]);
+		}
+	}
+
+	bool running() noexcept
+		{ return control != 0U; }
+
+	Config config() noexcept
+		{ return currentConfig; }
+
+	Counters snapshot() noexcept
+		{ return {static_cast<uint64_t>(blocks) * blockSize, blocks, errors, wallClock::now64()}; }
+
+	uint32_t report(const std::string_view name, const Counters &before) noexcept
+	{
+		if (!control)
+			return 0U;
+		const auto after{snapshot()};
+		const auto bytes{after.bytes - before.bytes};
+		const auto ticks{after.ticks - before.ticks};
+		const auto bytesPerSecond
+		{
+			ticks ? static_cast<uint32_t>((bytes * rcc_ahb_frequency) / ticks) : 0U
+		};
+		host.result("busLoad"sv, name, "bytes"sv, bytes);
+		host.result("busLoad"sv, name, "bytesPerSecond"sv, bytesPerSecond);
+		host.result("busLoad"sv, name, "errors"sv, after.errors - before.errors);
+		return bytesPerSecond;
+	}
+
+	// Account for the block a stream just finished and set it going again
+	[[RAMFUNC]] static void serviceStream(const size_t stream) noexcept
+	{
+		const auto flags{DMA_LISR(loadDMA) >> flagShifts[stream]};
+		clearFlags(stream);
+		if (flags & DMA_LISR_TEIF0)
+		{
+			// The stream disables itself on a transfer error - leave it off rather than storm on the fault
+			errors = errors + 1U;
+			return;
+		}
+		if (!(flags & DMA_LISR_TCIF0))
+			return;
+		blocks = blocks + 1U;
+		if (control)
+			arm(stream);
+	}
+} // namespace semihosting::busLoad
+
+using namespace semihosting::busLoad;
+
+void dma2_stream0_isr()
+	{ serviceStream(0U); }
+
+void dma2_stream1_isr()
+	{ serviceStream(1U); }
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BUS_LOAD_HXX
+#define BUS_LOAD_HXX
+
+#include <cstdint>
+#include <string_view>
+
+namespace semihosting::busLoad
+{
+	enum class Priority : uint8_t
+	{
+		low = 0U,
+		medium = 1U,
+		high = 2U,
+		veryHigh = 3U,
+	};
+
+	struct Config final
+	{
+		// The priority the DMA streams arbitrate for the bus with
+		Priority priority;
+		// Beats per DMA burst - one of 1 (single), 4, 8 or 16
+		uint8_t burst;
+	};
+
+	struct Counters final
+	{
+		// Bytes the DMA streams have moved
+		uint64_t bytes;
+		// Blocks that completed, and so how many times the streams were rearmed
+		uint32_t blocks;
+		// Blocks that ended in a transfer error
+		uint32_t errors;
+		// The wall clock at the time of the snapshot - unlike the DWT cycle counter, this keeps going while the
+		// core is halted, so intervals can run past a cycle counter wrap
+		uint64_t ticks;
+	};
+
+	/*
+	 * Start DMA2 streams 0 and 1 copying blocks of SRAM memory-to-memory back to back, rearming from their
+	 * transfer complete interrupts, so the AHB matrix is kept busy for as long as the load runs. Returns
+	 * false without starting anything if the burst size is not one the streams can do.
+	 *
+	 * The load only runs while the core does. Interrupts aren't taken while it is halted, so each stream
+	 * finishes the block it is on and then sits idle until the core resumes - probe accesses made during a
+	 * halt, such as those servicing a semihosting call, see at most a block's worth of contention. Keeping
+	 * the streams going without the core would need them to be timer-paced, as memory-to-memory can't run in
+	 * circular mode, and on this part the only timer that can pace DMA2 is TIM1, which the timekeeping tests
+	 * already use as their timebase.
+	 */
+	[[nodiscard]] bool start(const Config &config) noexcept;
+	void stop() noexcept;
+	[[nodiscard]] bool running() noexcept;
+	[[nodiscard]] Config config() noexcept;
+	[[nodiscard]] Counters snapshot() noexcept;
+	// Emit how much the load moved since `before` was taken as `[#] busLoad <name> <metric> <value>` lines,
+	// returning the bytes moved per second. That rate is over the wall clock, so the time spent halted, when
+	// the load is idle, pulls it down
+	uint32_t report(std::string_view name, const Counters &before) noexcept;
+} // namespace semihosting::busLoad
+
+#endif /*BUS_LOAD_HXX*/
@@ -36,23 +36,34 @@
 #include <type_traits>
 #include <substrate/promotion_helpers>
 #include "syscalls.hxx"
+#include "ramfunc.hxx"
+#include "perfScope.hxx"
 
 namespace semihosting::host::console
 {
+	using namespace std::literals::string_view_literals;
+
 	template<typename Int> struct AsInt final
 	{
 	private:
 		using UInt = substrate::promoted_type_t<std::make_unsigned_t<Int>>;
 		Int _value;
 
-		[[gnu::noinline]] UInt formatTo(const int32_t fd, const UInt number) const noexcept
+		[[gnu::noinline, RAMFUNC]] UInt formatTo(const int32_t fd, const UInt number) const noexcept
 		{
 			if (number < 10)
 				static_cast<void>(writeChar(static_cast<char>(number + '0')));
 			else
 			{
-				const auto digit{number - formatTo(fd, number / 10U) * 10U};
-				static_cast<void>(writeChar(static_cast<char>(digit + '0')));
+				const auto quotient{formatTo(fd, number / 10U)};
+				// Scope just the digit conversion - with the console write in it, the region would be too long
+				// for the event counters to be exact
+				char digit{};
+				{
+					const perf::PerfScope scope{"console.formatDigit"sv};
+					digit = static_cast<char>(number - quotient * 10U + '0');
+				}
+				static_cast<void>(writeChar(digit));
 			}
 			return number;
 		}
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ENUM_NAMES_HXX
+#define ENUM_NAMES_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+#include <type_traits>
+
+#include "syscallTypes.hxx"
+
+namespace semihosting::types
+{
+	using namespace std::literals::string_view_literals;
+
+	template<typename Enum> struct EnumName final
+	{
+		Enum value;
+		std::string_view name;
+		std::string_view description{};
+	};
+
+	// Specialise this with a `constexpr static std::array<EnumName<Enum>, N> names` member to give an enum
+	// names. Everything built from it is constexpr, so the tables live in flash and cost no RAM.
+	template<typename Enum> struct EnumTraits { };
+
+	namespace internal
+	{
+		template<typename Enum, typename = void> struct HasEnumNames : std::false_type { };
+		template<typename Enum> struct HasEnumNames<Enum, std::void_t<decltype(EnumTraits<Enum>::names)>> :
+			std::true_type { };
+
+		constexpr inline uint8_t noEntry{UINT8_MAX};
+
+		template<typename Enum> struct EnumNameTable final
+		{
+			using underlying_t = std::underlying_type_t<Enum>;
+			constexpr static auto &entries{EnumTraits<Enum>::names};
+			static_assert(entries.size() != 0U && entries.size() < noEntry, "Enum name tables must have 1 to 254 entries");
+
+			[[nodiscard]] constexpr static underlying_t lowestValue() noexcept
+			{
+				auto result{static_cast<underlying_t>(entries[0].value)};
+				for (const auto &entry : entries)
+				{
+					if (static_cast<underlying_t>(entry.value) < result)
+						result = static_cast<underlying_t>(entry.value);
+				}
+				return result;
+			}
+
+			[[nodiscard]] constexpr static underlying_t highestValue() noexcept
+			{
+				auto result{static_cast<underlying_t>(entries[0].value)};
+				for (const auto &entry : entries)
+				{
+					if (static_cast<underlying_t>(entry.value) > result)
+						result = static_cast<underlying_t>(entry.value);
+				}
+				return result;
+			}
+
+			constexpr static underlying_t lowest{lowestValue()};
+			constexpr static size_t span{static_cast<size_t>(highestValue() - lowest) + 1U};
+			static_assert(span <= 256U, "Enum values are too sparse for a direct lookup table");
+
+			// Maps (value - lowest) to the index of that value's entry, so lookups are a bounds check and two loads
+			[[nodiscard]] constexpr static std::array<uint8_t, span> buildIndex() noexcept
+			{
+				std::array<uint8_t, span> result{};
+				for (auto &index : result)
+					index = noEntry;
+				for (size_t entry{0U}; entry < entries.size(); ++entry)
+					result[static_cast<size_t>(static_cast<underlying_t>(entries[entry].value) - lowest)] =
+						static_cast<uint8_t>(entry);
+				return result;
+			}
+
+			constexpr static std::array<uint8_t, span> index{buildIndex()};
+
+			[[nodiscard]] constexpr static const EnumName<Enum> *find(const Enum value) noexcept
+			{
+				const auto rawValue{static_cast<underlying_t>(value)};
+				if (rawValue < lowest || static_cast<size_t>(rawValue - lowest) >= span)
+					return nullptr;
+				const auto entry{index[static_cast<size_t>(rawValue - lowest)]};
+				return entry == noEntry ? nullptr : &entries[entry];
+			}
+		};
+	} // namespace internal
+
+	template<typename Enum> constexpr inline bool hasEnumNames = internal::HasEnumNames<Enum>::value;
+
+	// Look up the name of an enum value, returning an empty view for values without one
+	template<typename Enum> [[nodiscard]] constexpr std::string_view enumName(const Enum value) noexcept
+	{
+		const auto *const entry{internal::EnumNameTable<Enum>::find(value)};
+		return entry ? entry->name : std::string_view{};
+	}
+
+	// Look up the long-form description of an enum value, returning an empty view for values without one
+	template<typename Enum> [[nodiscard]] constexpr std::string_view enumDescription(const Enum value) noexcept
+	{
+		const auto *const entry{internal::EnumNameTable<Enum>::find(value)};
+		return entry ? entry->description : std::string_view{};
+	}
+
+	template<> struct EnumTraits<Syscall>
+	{
+		constexpr static std::array<EnumName<Syscall>, 25> names
+		{{
+			{Syscall::open, "SYS_OPEN"sv},
+			{Syscall::close, "SYS_CLOSE"sv},
+			{Syscall::writeChar, "SYS_WRITEC"sv},
+			{Syscall::writeNulStr, "SYS_WRITE0"sv},
+			{Syscall::write, "SYS_WRITE"sv},
+			{Syscall::read, "SYS_READ"sv},
+			{Syscall::readChar, "SYS_READC"sv},
+			{Syscall::isError, "SYS_ISERROR"sv},
+			{Syscall::isTTY, "SYS_ISTTY"sv},
+			{Syscall::seek, "SYS_SEEK"sv},
+			{Syscall::fileLength, "SYS_FLEN"sv},
+			{Syscall::tempName, "SYS_TMPNAM"sv},
+			{Syscall::remove, "SYS_REMOVE"sv},
+			{Syscall::rename, "SYS_RENAME"sv},
+			{Syscall::clock, "SYS_CLOCK"sv},
+			{Syscall::time, "SYS_TIME"sv},
+			{Syscall::system, "SYS_SYSTEM"sv},
+			{Syscall::lastErrno, "SYS_ERRNO"sv},
+			{Syscall::readCommandLine, "SYS_GET_CMDLINE"sv},
+			{Syscall::heapInfo, "SYS_HEAPINFO"sv},
+			{Syscall::exit, "SYS_EXIT"sv},
+			{Syscall::exitExtended, "SYS_EXIT_EXTENDED"sv},
+			{Syscall::elapsed, "SYS_ELAPSED"sv},
+			{Syscall::tickFrequency, "SYS_TICKFREQ"sv},
+			{Syscall::batch, "SYS_BATCH"sv},
+		}};
+	};
+
+	template<> struct EnumTraits<OpenMode>
+	{
+		constexpr static std::array<EnumName<OpenMode>, 12> names
+		{{
+			{OpenMode::read, "r"sv},
+			{OpenMode::readBinary, "rb"sv},
+			{OpenMode::readPlus, "r+"sv},
+			{OpenMode::readBinaryPlus, "r+b"sv},
+			{OpenMode::write, "w"sv},
+			{OpenMode::writeBinary, "wb"sv},
+			{OpenMode::writePlus, "w+"sv},
+			{OpenMode::writeBinaryPlus, "w+b"sv},
+			{OpenMode::append, "a"sv},
+			{OpenMode::appendBinary, "ab"sv},
+			{OpenMode::appendPlus, "a+"sv},
+			{OpenMode::appendBinaryPlus, "a+b"sv},
+		}};
+	};
+
+	template<> struct EnumTraits<SemihostingResult>
+	{
+		constexpr static std::array<EnumName<SemihostingResult>, 2> names
+		{{
+			{SemihostingResult::success, "success"sv},
+			{SemihostingResult::failure, "failure"sv},
+		}};
+	};
+
+	template<> struct EnumTraits<FileIOErrno>
+	{
+		constexpr static std::array<EnumName<FileIOErrno>, 22> names
+		{{
+			{FileIOErrno::success, "FILEIO_SUCCESS"sv, "no error"sv},
+			{FileIOErrno::notPermitted, "FILEIO_EPERM"sv, "Operation not permitted"sv},
+			{FileIOErrno::noSuchEntity, "FILEIO_ENOENT"sv, "No such file or directory"sv},
+			{FileIOErrno::syscallInterrupted, "FILEIO_EINTR"sv, "Interrupted system call"sv},
+			{FileIOErrno::ioError, "FILEIO_EIO"sv, "I/O error"sv},
+			{FileIOErrno::badFD, "FILEIO_EBADF"sv, "Bad file number"sv},
+			{FileIOErrno::accessError, "FILEIO_EACCESS"sv, "Permission denied"sv},
+			{FileIOErrno::addressFault, "FILEIO_EFAULT"sv, "Bad address"sv},
+			{FileIOErrno::busy, "FILEIO_EBUSY"sv, "Device or resource busy"sv},
+			{FileIOErrno::alreadyExists, "FILEIO_EEXIST"sv, "File already exists"sv},
+			{FileIOErrno::noSuchDevice, "FILEIO_ENODEV"sv, "No such device"sv},
+			{FileIOErrno::notADir, "FILEIO_ENOTDIR"sv, "Not a directory"sv},
+			{FileIOErrno::isADir, "FILEIO_EISDIR"sv, "Is a directory"sv},
+			{FileIOErrno::argumentInvalid, "FILEIO_EINVAL"sv, "Invalid argument"sv},
+			{FileIOErrno::fileTableFull, "FILEIO_ENFILE"sv, "File table overflow"sv},
+			{FileIOErrno::tooManyOpenFiles, "FILEIO_EMFILE"sv, "Too many open files"sv},
+			{FileIOErrno::fileTooLarge, "FILEIO_EFBIG"sv, "File too large"sv},
+			{FileIOErrno::outOfSpace, "FILEIO_ENOSPC"sv, "No space left on device"sv},
+			{FileIOErrno::illegalSeek, "FILEIO_ESPIPE"sv, "Illegal seek"sv},
+			{FileIOErrno::fsReadOnly, "FILEIO_EROFS"sv, "Read-only file system"sv},
+			{FileIOErrno::syscallInvalid, "FILEIO_ENOSYS"sv, "Invalid system call number"sv},
+			{FileIOErrno::fileNameTooLong, "FILEIO_ENAMETOOLONG"sv, "File name too long"sv},
+		}};
+	};
+
+	template<> struct EnumTraits<ExitReason>
+	{
+		constexpr static std::array<EnumName<ExitReason>, 18> names
+		{{
+			{ExitReason::branchThroughZero, "ADP_Stopped_BranchThroughZero"sv},
+			{ExitReason::undefinedInsn, "ADP_Stopped_UndefinedInstr"sv},
+			{ExitReason::softwareInterrupt, "ADP_Stopped_SoftwareInterrupt"sv},
+			{ExitReason::prefetchAbort, "ADP_Stopped_PrefetchAbort"sv},
+			{ExitReason::dataAbort, "ADP_Stopped_DataAbort"sv},
+			{ExitReason::addressException, "ADP_Stopped_AddressException"sv},
+			{ExitReason::irq, "ADP_Stopped_IRQ"sv},
+			{ExitReason::fiq, "ADP_Stopped_FIQ"sv},
+			{ExitReason::breakpoint, "ADP_Stopped_BreakPoint"sv},
+			{ExitReason::watchpoint, "ADP_Stopped_WatchPoint"sv},
+			{ExitReason::stepComplete, "ADP_Stopped_StepComplete"sv},
+			{ExitReason::runtimeErrorUnknown, "ADP_Stopped_RunTimeErrorUnknown"sv},
+			{ExitReason::internalError, "ADP_Stopped_InternalError"sv},
+			{ExitReason::userInterruption, "ADP_Stopped_UserInterruption"sv},
+			{ExitReason::applicationExit, "ADP_Stopped_ApplicationExit"sv},
+			{ExitReason::stackOverflow, "ADP_Stopped_StackOverflow"sv},
+			{ExitReason::divideByZero, "ADP_Stopped_DivisionByZero"sv},
+			{ExitReason::osSpecific, "ADP_Stopped_OSSpecific"sv},
+		}};
+	};
+} // namespace semihosting::types
+
+#endif /*ENUM_NAMES_HXX*/
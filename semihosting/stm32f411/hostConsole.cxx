@@ -34,6 +34,8 @@
 #include "syscalls.hxx"
 #include "hostConsole.hxx"
 #include "consoleHelpers.hxx"
+#include "perfScope.hxx"
+#include "ramfunc.hxx"
 
 using namespace std::literals::string_view_literals;
 using namespace semihosting::types;
@@ -56,18 +58,25 @@ namespace semihosting::host::console
 			semihosting::close(fdToHost) == SemihostingResult::success;
 	}
 
-	void Console::write(const std::string_view &value) const noexcept
+	[[RAMFUNC]] void Console::write(const std::string_view &value) const noexcept
 	{
+		const perf::PerfScope scope{"console.write"sv};
 		const auto endChar{value.back() == '\0' ? value.length() - 1U : value.length()};
 		const substrate::span data{value.data(), endChar};
 		static_cast<void>(semihosting::write(fdToHost, data));
 	}
 
 	void Console::write(const int64_t value) const noexcept
-		{ AsInt{value}.convert(fdToHost); }
+	{
+		const perf::PerfScope scope{"console.writeInt"sv};
+		AsInt{value}.convert(fdToHost);
+	}
 
 	void Console::write(const uint64_t value) const noexcept
-		{ AsInt{value}.convert(fdToHost); }
+	{
+		const perf::PerfScope scope{"console.writeInt"sv};
+		AsInt{value}.convert(fdToHost);
+	}
 
 	// Output `[!]` in red
 	void Console::errorPrefix() const noexcept
@@ -84,4 +93,8 @@ namespace semihosting::host::console
 	// Output `[~]` in cyan
 	void Console::infoPrefix() const noexcept
 		{ write("\x1b[36m[~]\x1b[0m "sv); }
+
+	// Output `[#]` in magenta
+	void Console::resultPrefix() const noexcept
+		{ write("\x1b[35m[#]\x1b[0m "sv); }
 } // namespace host
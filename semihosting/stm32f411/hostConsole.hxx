@@ -37,6 +37,8 @@
 #include <string_view>
 #include <type_traits>
 
+#include "enumNames.hxx"
+
 namespace semihosting::host::console
 {
 	using namespace std::literals::string_view_literals;
@@ -73,6 +75,7 @@ namespace semihosting::host::console
 		void warningPrefix() const noexcept;
 		void noticePrefix() const noexcept;
 		void infoPrefix() const noexcept;
+		void resultPrefix() const noexcept;
 
 		template<typename T> std::enable_if_t<isNumeric<T> && !std::is_same_v<T, int64_t> &&
 			std::is_signed_v<T> && !std::is_enum_v<T>> write(const T value) const noexcept
@@ -88,8 +91,16 @@ namespace semihosting::host::console
 			write(widenedValue);
 		}
 
+		// Enums with a name table print by name, falling back to their numeric value for unnamed values
 		template<typename T> std::enable_if_t<std::is_enum_v<T>> write(const T value) const noexcept
-			{ write(static_cast<std::underlying_type_t<T>>(value)); }
+		{
+			if constexpr (types::hasEnumNames<T>)
+			{
+				if (const auto name{types::enumName(value)}; !name.empty())
+					return write(name);
+			}
+			write(static_cast<std::underlying_type_t<T>>(value));
+		}
 
 	public:
 		Console() noexcept = default;
@@ -132,6 +143,15 @@ namespace semihosting::host::console
 			writeln(std::forward<Values>(values)...);
 		}
 
+		// Emit a benchmark result line of the form `[#] <benchmark> <metric> [parameters...] <value>`
+		template<typename... Values> void result(const std::string_view &benchmark, Values &&...values) const noexcept
+		{
+			resultPrefix();
+			write(benchmark);
+			((write(" "sv), write(values)), ...);
+			writeln();
+		}
+
 		[[nodiscard]] int32_t stdinFD() const noexcept { return fdFromHost; }
 		[[nodiscard]] int32_t stdoutFD() const noexcept { return fdToHost; }
 	};
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inputReader.hxx"
+#include "syscalls.hxx"
+
+namespace semihosting::host::console
+{
+	[[nodiscard]] static bool isWhitespace(const char value) noexcept
+		{ return value == ' ' || value == '\t' || value == '\r' || value == '\n'; }
+
+	bool InputReader::fill() noexcept
+	{
+		if (_position != _filled)
+			return true;
+		if (_endOfInput)
+			return false;
+		_position = 0U;
+		_filled = 0U;
+		// SYS_READ returns how many bytes it did *not* read, so a full count means end of input
+		const auto notRead{semihosting::read(_fd, _buffer.data(), _buffer.size())};
+		if (notRead < 0 || static_cast<size_t>(notRead) >= _buffer.size())
+		{
+			_endOfInput = true;
+			return false;
+		}
+		_filled = _buffer.size() - static_cast<size_t>(notRead);
+		return true;
+	}
+
+	std::optional<char> InputReader::peek() noexcept
+	{
+		if (!fill())
+			return std::nullopt;
+		return _buffer[_position];
+	}
+
+	std::optional<char> InputReader::read() noexcept
+	{
+		if (!fill())
+			return std::nullopt;
+		return _buffer[_position++];
+	}
+
+	void InputReader::skipWhitespace() noexcept
+	{
+		while (const auto value{peek()})
+		{
+			if (!isWhitespace(*value))
+				break;
+			++_position;
+		}
+	}
+
+	void InputReader::skipLine() noexcept
+	{
+		while (const auto value{read()})
+		{
+			if (*value == '\n')
+				break;
+		}
+	}
+
+	bool InputReader::endOfLine() noexcept
+	{
+		while (const auto value{peek()})
+		{
+			if (*value == '\r' || *value == '\n')
+				return true;
+			if (!isWhitespace(*value))
+				return false;
+			++_position;
+		}
+		return true;
+	}
+
+	std::optional<std::string_view> InputReader::readLine(const substrate::span<char> storage) noexcept
+	{
+		if (!peek())
+			return std::nullopt;
+		size_t length{0U};
+		while (const auto value{read()})
+		{
+			if (*value == '\n')
+				break;
+			if (length < storage.size())
+				storage[length++] = *value;
+		}
+		// Strip the carriage return from CRLF line endings
+		if (length && storage[length - 1U] == '\r')
+			--length;
+		return std::string_view{storage.data(), length};
+	}
+
+	std::optional<std::string_view> InputReader::readToken(const substrate::span<char> storage) noexcept
+	{
+		skipWhitespace();
+		if (!peek())
+			return std::nullopt;
+		size_t length{0U};
+		while (const auto value{peek()})
+		{
+			if (isWhitespace(*value))
+				break;
+			if (length < storage.size())
+				storage[length++] = *value;
+			++_position;
+		}
+		return std::string_view{storage.data(), length};
+	}
+
+	std::optional<uint64_t> InputReader::parseUnsigned(std::string_view number) noexcept
+	{
+		uint64_t base{10U};
+		if (number.size() > 2U && number[0] == '0' && (number[1] == 'x' || number[1] == 'X'))
+		{
+			base = 16U;
+			number.remove_prefix(2U);
+		}
+		if (number.empty())
+			return std::nullopt;
+		uint64_t result{0U};
+		for (const auto value : number)
+		{
+			uint64_t digit{};
+			if (value >= '0' && value <= '9')
+				digit = static_cast<uint64_t>(value - '0');
+			else if (base == 16U && value >= 'a' && value <= 'f')
+				digit = static_cast<uint64_t>(value - 'a') + 10U;
+			else if (base == 16U && value >= 'A' && value <= 'F')
+				digit = static_cast<uint64_t>(value - 'A') + 10U;
+			else
+				return std::nullopt;
+			// Reject anything that would overflow 64 bits
+			if (result > (UINT64_MAX - digit) / base)
+				return std::nullopt;
+			result = (result * base) + digit;
+		}
+		return result;
+	}
+} // namespace semihosting::host::console
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INPUT_READER_HXX
+#define INPUT_READER_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <substrate/span>
+
+namespace semihosting::host::console
+{
+	// Block-buffered reader over a semihosting file descriptor (typically Console::stdinFD()). Each refill is a
+	// single SYS_READ for up to a buffer's worth of data, rather than the halt per byte SYS_READC costs.
+	struct InputReader final
+	{
+	private:
+		constexpr static size_t bufferSize{128U};
+		constexpr static size_t maxNumberLength{24U};
+
+		int32_t _fd;
+		std::array<char, bufferSize> _buffer{};
+		size_t _position{0U};
+		size_t _filled{0U};
+		bool _endOfInput{false};
+
+		[[nodiscard]] bool fill() noexcept;
+		void skipWhitespace() noexcept;
+		[[nodiscard]] static std::optional<uint64_t> parseUnsigned(std::string_view number) noexcept;
+
+	public:
+		InputReader(const int32_t fd) noexcept : _fd{fd} { }
+		InputReader(const InputReader &) = delete;
+		InputReader(InputReader &&) = delete;
+		InputReader &operator =(const InputReader &) = delete;
+		InputReader &operator =(InputReader &&) = delete;
+
+		// Look at the next character without consuming it
+		[[nodiscard]] std::optional<char> peek() noexcept;
+		[[nodiscard]] std::optional<char> read() noexcept;
+		// Read up to the next newline into storage, returning the line without its line ending. Lines longer
+		// than storage are truncated and the remainder discarded.
+		[[nodiscard]] std::optional<std::string_view> readLine(substrate::span<char> storage) noexcept;
+		// Skip leading whitespace and read the next whitespace-delimited token into storage. Tokens longer
+		// than storage are truncated and the remainder discarded.
+		[[nodiscard]] std::optional<std::string_view> readToken(substrate::span<char> storage) noexcept;
+		// Discard everything up to and including the next newline
+		void skipLine() noexcept;
+		// Skip spaces and tabs, then report whether the rest of the current line is empty
+		[[nodiscard]] bool endOfLine() noexcept;
+		[[nodiscard]] bool endOfInput() const noexcept { return _endOfInput && _position == _filled; }
+
+		// Read the next token as a decimal or 0x-prefixed hexadecimal number, failing if it is not a
+		// number, is too long to be one, or does not fit in Int
+		template<typename Int> [[nodiscard]] std::enable_if_t<std::is_integral_v<Int> && !std::is_same_v<Int, bool>,
+			std::optional<Int>> readNumber() noexcept
+		{
+			// One spare byte so a token too long to be a number fills the storage, rather than silently being
+			// truncated down to a prefix that might parse
+			std::array<char, maxNumberLength + 1U> storage{};
+			const auto token{readToken(storage)};
+			if (!token || token->empty() || token->size() > maxNumberLength)
+				return std::nullopt;
+			auto digits{*token};
+			const auto negative{digits.front() == '-'};
+			if (negative)
+			{
+				if constexpr (std::is_unsigned_v<Int>)
+					return std::nullopt;
+				digits.remove_prefix(1U);
+			}
+			const auto magnitude{parseUnsigned(digits)};
+			if (!magnitude)
+				return std::nullopt;
+			using UInt = std::make_unsigned_t<Int>;
+			// The most negative value of a signed type has a magnitude one larger than its maximum
+			const uint64_t limit{static_cast<UInt>(std::numeric_limits<Int>::max()) + (negative ? 1U : 0U)};
+			if (*magnitude > limit)
+				return std::nullopt;
+			const auto value{static_cast<UInt>(*magnitude)};
+			return static_cast<Int>(negative ? static_cast<UInt>(~value + 1U) : value);
+		}
+	};
+} // namespace semihosting::host::console
+
+#endif /*INPUT_READER_HXX*/
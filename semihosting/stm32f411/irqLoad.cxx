@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/dbgmcu.h>
+#include <libopencm3/cm3/nvic.h>
+#include "irqLoad.hxx"
+#include "hostConsole.hxx"
+#include "ramfunc.hxx"
+
+using namespace std::literals::string_view_literals;
+
+namespace semihosting::irqLoad
+{
+	using host::console::host;
+
+	// Written only by the interrupt handler
+	static volatile uint32_t serviced{0U};
+	static volatile uint32_t missed{0U};
+	// Written only by thread context
+	static uint32_t halts{0U};
+	static uint32_t haltMissed{0U};
+	static uint32_t maxHaltMissed{0U};
+	// Timer ticks between interrupts, or 0 if the load is not running
+	static uint32_t period{0U};
+
+	void start(const uint32_t rate) noexcept
+	{
+		// TIM2 is clocked at twice APB1 as APB1 is divided down from the core clock
+		const auto timerFrequency{rcc_apb1_frequency * 2U};
+		if (!rate || rate > timerFrequency)
+			return;
+		period = timerFrequency / rate;
+
+		rcc_periph_clock_enable(RCC_TIM2);
+		// Make sure the timer keeps counting through debug halts, as it is the measure of what was missed
+		DBGMCU_APB1_FZ = DBGMCU_APB1_FZ & ~DBGMCU_APB1_FZ_DBG_TIM2_STOP;
+		// Free-run the full 32-bit counter at the timer clock, raising an interrupt each time it reaches CCR1
+		timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+		timer_set_prescaler(TIM2, 0U);
+		timer_set_period(TIM2, UINT32_MAX);
+		timer_continuous_mode(TIM2);
+		timer_set_counter(TIM2, 0U);
+		timer_set_oc_value(TIM2, TIM_OC1, period);
+		timer_clear_flag(TIM2, TIM_SR_CC1IF);
+		timer_enable_irq(TIM2, TIM_DIER_CC1IE);
+		// Run the load above everything else so it behaves like a hard real-time task would
+		nvic_set_priority(NVIC_TIM2_IRQ, 0U);
+		nvic_enable_irq(NVIC_TIM2_IRQ);
+		timer_enable_counter(TIM2);
+	}
+
+	bool running() noexcept
+		{ return period != 0U; }
+
+	Counters snapshot() noexcept
+		{ return {serviced, missed, halts, haltMissed, maxHaltMissed}; }
+
+	HaltScope::HaltScope() noexcept : _missed{missed} { }
+
+	HaltScope::~HaltScope() noexcept
+	{
+		if (!period)
+			return;
+		// The compare event that fell due during the halt is pending now the core is running again - let it
+		// be taken before looking at the count, so the periods lost to the halt are accounted for
+		__asm__ volatile("isb" ::: "memory");
+		const auto lost{missed - _missed};
+		++halts;
+		haltMissed += lost;
+		if (lost > maxHaltMissed)
+			maxHaltMissed = lost;
+	}
+
+	void report(const std::string_view name, const Counters &before) noexcept
+	{
+		if (!period)
+			return;
+		const auto after{snapshot()};
+		host.result("irqLoad"sv, name, "serviced"sv, after.serviced - before.serviced);
+		host.result("irqLoad"sv, name, "missed"sv, after.missed - before.missed);
+		host.result("irqLoad"sv, name, "halts"sv, after.halts - before.halts);
+		host.result("irqLoad"sv, name, "haltMissed"sv, after.haltMissed - before.haltMissed);
+		// This is a running maximum, so is reported as-is rather than against the earlier snapshot
+		host.result("irqLoad"sv, name, "maxHaltMissed"sv, after.maxHaltMissed);
+	}
+} // namespace semihosting::irqLoad
+
+using namespace semihosting::irqLoad;
+
+// The load itself. The counter keeps running while the core is halted, so however late this runs, the
+// distance the counter has moved past the compare point says how many periods went by unserviced
+[[RAMFUNC]] void tim2_isr()
+{
+	TIM_SR(TIM2) = ~TIM_SR_CC1IF;
+	const auto due{TIM_CCR1(TIM2)};
+	const auto skipped{(TIM_CNT(TIM2) - due) / period};
+	if (skipped)
+		missed = missed + skipped;
+	serviced = serviced + 1U;
+	TIM_CCR1(TIM2) = due + (skipped + 1U) * period;
+}
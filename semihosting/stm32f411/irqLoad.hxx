@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IRQ_LOAD_HXX
+#define IRQ_LOAD_HXX
+
+#include <cstdint>
+#include <string_view>
+
+namespace semihosting::irqLoad
+{
+	struct Counters final
+	{
+		// Timer interrupts that ran
+		uint32_t serviced;
+		// Timer periods that went by without their interrupt running, because the core was halted or busy
+		uint32_t missed;
+		// Semihosting calls (and so debug halts) made
+		uint32_t halts;
+		// Of the missed interrupts, those that went by during a semihosting call
+		uint32_t haltMissed;
+		// The most interrupts missed across any one semihosting call
+		uint32_t maxHaltMissed;
+	};
+
+	/*
+	 * Counts the interrupts that would have run during one semihosting call but didn't. Construct one
+	 * immediately around the breakpoint - on destruction it lets the interrupt the halt left pending run,
+	 * which is what accounts for the periods lost while halted.
+	 */
+	struct HaltScope final
+	{
+	private:
+		uint32_t _missed;
+
+	public:
+		HaltScope() noexcept;
+		HaltScope(const HaltScope &) = delete;
+		HaltScope(HaltScope &&) = delete;
+		~HaltScope() noexcept;
+		HaltScope &operator =(const HaltScope &) = delete;
+		HaltScope &operator =(HaltScope &&) = delete;
+	};
+
+	// Start TIM2 raising an interrupt rate times a second, for as long as the firmware runs
+	void start(uint32_t rate) noexcept;
+	[[nodiscard]] bool running() noexcept;
+	[[nodiscard]] Counters snapshot() noexcept;
+	// Emit how the interrupt load fared since `before` was taken as `[#] irqLoad <name> <metric> <value>` lines
+	void report(std::string_view name, const Counters &before) noexcept;
+} // namespace semihosting::irqLoad
+
+#endif /*IRQ_LOAD_HXX*/
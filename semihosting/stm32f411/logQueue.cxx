@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <substrate/span>
+#include <libopencm3/cm3/dwt.h>
+#include "logQueue.hxx"
+#include "hostConsole.hxx"
+#include "syscalls.hxx"
+
+using namespace std::literals::string_view_literals;
+
+namespace semihosting::host::console
+{
+	LogQueue logQueue{};
+
+	// Records are written in the same colour as info() lines, tagged with their cycle counter timestamp
+	constexpr static auto recordPrefix{"\x1b[36m[~]\x1b[0m @"sv};
+	constexpr static auto lineEnding{"\r\n"sv};
+	// Long enough for the prefix, a 40 character message, and the timestamp and two values
+	constexpr static size_t batchLength{128U};
+
+	// Accumulates formatted records so a whole batch of them goes to the host in one SYS_WRITE
+	struct Batch final
+	{
+	private:
+		std::array<char, batchLength> buffer{};
+		size_t used{0U};
+
+	public:
+		[[nodiscard]] size_t remaining() const noexcept { return buffer.size() - used; }
+
+		void flush() noexcept
+		{
+			if (!used)
+				return;
+			static_cast<void>(semihosting::write(host.stdoutFD(), substrate::span{buffer.data(), used}));
+			used = 0U;
+		}
+
+		void append(const std::string_view value) noexcept
+		{
+			for (const auto chr : value)
+			{
+				if (!remaining())
+					flush();
+				buffer[used++] = chr;
+			}
+		}
+
+		void append(uint32_t value) noexcept
+		{
+			std::array<char, 10> digits{};
+			size_t count{0U};
+			do
+			{
+				digits[count++] = static_cast<char>('0' + (value % 10U));
+				value /= 10U;
+			}
+			while (value);
+			if (remaining() < count)
+				flush();
+			while (count)
+				buffer[used++] = digits[--count];
+		}
+	};
+
+	LogQueue::LogQueue() noexcept
+	{
+		// Each slot starts out free for the producer whose claimed position lands on it
+		for (size_t index{0U}; index < slots.size(); ++index)
+			slots[index].sequence.store(index, std::memory_order_relaxed);
+	}
+
+	bool LogQueue::push(const std::string_view message, const uint32_t valueCount, const uint32_t first,
+		const uint32_t second) noexcept
+	{
+		const auto timestamp{dwt_read_cycle_counter()};
+		auto position{writePosition.load(std::memory_order_relaxed)};
+		Slot *slot{nullptr};
+		while (true)
+		{
+			slot = &slots[position & (capacity - 1U)];
+			const auto sequence{slot->sequence.load(std::memory_order_acquire)};
+			const auto difference{static_cast<int32_t>(sequence - position)};
+			// The slot is free for this position - try to claim it, and on losing the race try again from the
+			// position the winner left behind
+			if (difference == 0)
+			{
+				if (writePosition.compare_exchange_weak(position, position + 1U, std::memory_order_relaxed))
+					break;
+			}
+			// The slot still holds a record from a lap ago that has not been flushed, so the queue is full
+			else if (difference < 0)
+			{
+				droppedRecords.fetch_add(1U, std::memory_order_relaxed);
+				return false;
+			}
+			// Another producer claimed this position since we read it, so catch up
+			else
+				position = writePosition.load(std::memory_order_relaxed);
+		}
+		slot->record = {timestamp, message, valueCount, {{first, second}}};
+		// Publish the record to the consumer
+		slot->sequence.store(position + 1U, std::memory_order_release);
+		return true;
+	}
+
+	size_t LogQueue::flush(const size_t maxRecords) noexcept
+	{
+		Batch batch{};
+		size_t count{0U};
+		for (; count < maxRecords; ++count)
+		{
+			auto &slot{slots[readPosition & (capacity - 1U)]};
+			// Stop at the first slot that is empty or whose producer has not finished filling it in yet
+			if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1U)
+				break;
+			const auto &record{slot.record};
+			batch.append(recordPrefix);
+			batch.append(record.timestamp);
+			batch.append(" "sv);
+			batch.append(record.message);
+			for (size_t index{0U}; index < record.valueCount; ++index)
+			{
+				batch.append(" "sv);
+				batch.append(record.values[index]);
+			}
+			batch.append(lineEnding);
+			// Hand the slot back to producers for its next lap round the queue
+			slot.sequence.store(readPosition + capacity, std::memory_order_release);
+			++readPosition;
+		}
+
+		if (const auto droppedNow{dropped()}; droppedNow != droppedReported)
+		{
+			batch.append(recordPrefix);
+			batch.append(dwt_read_cycle_counter());
+			batch.append(" log queue full, dropped "sv);
+			batch.append(droppedNow - droppedReported);
+			batch.append(" records"sv);
+			batch.append(lineEnding);
+			droppedReported = droppedNow;
+		}
+		batch.flush();
+		return count;
+	}
+} // namespace semihosting::host::console
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LOG_QUEUE_HXX
+#define LOG_QUEUE_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <string_view>
+
+namespace semihosting::host::console
+{
+	struct LogRecord final
+	{
+		// Cycle counter value at the time the record was pushed
+		uint32_t timestamp;
+		// Must refer to storage that outlives the record, such as a string literal
+		std::string_view message;
+		uint32_t valueCount;
+		std::array<uint32_t, 2> values;
+	};
+
+	/*
+	 * A bounded multi-producer, single-consumer queue of log records. Any context, including interrupt
+	 * handlers at any priority, may push() without masking interrupts - slots are claimed with a
+	 * compare-and-swap on the write position and each slot's sequence number says when it has been filled in.
+	 * Records pushed while the queue is full are counted and dropped rather than blocking. Only thread
+	 * context may flush(), which drains the queue to the host console in as few writes as it can.
+	 */
+	struct LogQueue final
+	{
+	public:
+		constexpr static size_t capacity{64U};
+		static_assert((capacity & (capacity - 1U)) == 0U, "capacity must be a power of 2");
+
+	private:
+		struct Slot final
+		{
+			std::atomic<uint32_t> sequence;
+			LogRecord record;
+		};
+
+		std::array<Slot, capacity> slots{};
+		std::atomic<uint32_t> writePosition{0U};
+		uint32_t readPosition{0U};
+		std::atomic<uint32_t> droppedRecords{0U};
+		uint32_t droppedReported{0U};
+
+		bool push(std::string_view message, uint32_t valueCount, uint32_t first, uint32_t second) noexcept;
+
+	public:
+		LogQueue() noexcept;
+
+		bool push(const std::string_view message) noexcept
+			{ return push(message, 0U, 0U, 0U); }
+		bool push(const std::string_view message, const uint32_t value) noexcept
+			{ return push(message, 1U, value, 0U); }
+		bool push(const std::string_view message, const uint32_t first, const uint32_t second) noexcept
+			{ return push(message, 2U, first, second); }
+
+		// Write out up to maxRecords queued records, returning how many were written
+		size_t flush(size_t maxRecords = capacity) noexcept;
+		[[nodiscard]] uint32_t dropped() const noexcept { return droppedRecords.load(std::memory_order_relaxed); }
+	};
+
+	extern LogQueue logQueue;
+} // namespace semihosting::host::console
+
+#endif /*LOG_QUEUE_HXX*/
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mailbox.hxx"
+
+namespace semihosting::resident
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+	[[gnu::section(".mailbox"), gnu::used]] Mailbox mailbox;
+	static bool commandRunning{false};
+	static uint32_t activeSequence{0U};
+
+	void initMailbox() noexcept
+	{
+		// The mailbox is not touched by startup, so a magic from before the reset may still be there. Take it
+		// down first so the host can't post a command into a mailbox we're about to declare drained
+		mailbox.magic = 0U;
+		__asm__ volatile("dmb" ::: "memory");
+		// Now bring the rest to a known state before advertising it again
+		mailbox.command = static_cast<uint32_t>(Command::none);
+		mailbox.status = static_cast<uint32_t>(Status::idle);
+		mailbox.completed = mailbox.sequence;
+		mailbox.elapsedCycles = 0U;
+		mailbox.resultCount = 0U;
+		mailbox.version = mailboxVersion;
+		// Write the magic last so the host only sees it once the rest is valid
+		__asm__ volatile("dmb" ::: "memory");
+		mailbox.magic = mailboxMagic;
+	}
+
+	bool commandPending() noexcept
+		{ return mailbox.sequence != mailbox.completed; }
+
+	void beginCommand() noexcept
+	{
+		activeSequence = mailbox.sequence;
+		mailbox.resultCount = 0U;
+		mailbox.elapsedCycles = 0U;
+		mailbox.status = static_cast<uint32_t>(Status::busy);
+		commandRunning = true;
+	}
+
+	void completeCommand(const Status status, const uint32_t elapsedCycles) noexcept
+	{
+		commandRunning = false;
+		mailbox.elapsedCycles = elapsedCycles;
+		mailbox.status = static_cast<uint32_t>(status);
+		// Make sure all the results are visible before we signal completion
+		__asm__ volatile("dmb" ::: "memory");
+		mailbox.completed = activeSequence;
+	}
+
+	void postResult(const uint32_t value) noexcept
+	{
+		if (!commandRunning || mailbox.resultCount >= mailbox.results.size())
+			return;
+		mailbox.results[mailbox.resultCount] = value;
+		mailbox.resultCount = mailbox.resultCount + 1U;
+	}
+} // namespace semihosting::resident
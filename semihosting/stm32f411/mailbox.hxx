@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MAILBOX_HXX
+#define MAILBOX_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+namespace semihosting::resident
+{
+	// Commands the host can post to the mailbox when the firmware is built in resident mode
+	enum class Command : uint32_t
+	{
+		none = 0U,
+		// Run the test with index parameters[0] from the suite
+		runTest = 1U,
+		// Run the full test suite
+		runSuite = 2U,
+		// Run the benchmark with index parameters[0], passing parameters[1..] to it
+		runBenchmark = 3U,
+		// Post the number of tests and benchmarks available as results
+		describe = 4U,
+		// Leave resident mode and shut the firmware down as normal
+		exit = 5U,
+		// Write the semihosting call trace out to the host (firmware built with TRACE=1 only)
+		dumpTrace = 6U,
+	};
+
+	enum class Status : uint32_t
+	{
+		idle = 0U,
+		busy = 1U,
+		passed = 2U,
+		failed = 3U,
+		invalidCommand = 4U,
+	};
+
+	constexpr static uint32_t mailboxMagic{0x54504d42U}; // 'BMPT'
+	constexpr static uint32_t mailboxVersion{2U};
+	constexpr static uintptr_t mailboxAddress{0x2001ff00U};
+
+	/*
+	 * The mailbox lives at the fixed address mailboxAddress (see f4discovery.ld). To issue a command
+	 * the host writes parameters and command, then increments sequence last. The firmware notices the
+	 * sequence change, sets status to busy, runs the command, fills in the results and status, and then
+	 * copies sequence into completed to signal it is done.
+	 */
+	struct Mailbox final
+	{
+		volatile uint32_t magic;
+		volatile uint32_t version;
+		volatile uint32_t command;
+		volatile uint32_t sequence;
+		std::array<volatile uint32_t, 4> parameters;
+		volatile uint32_t status;
+		volatile uint32_t completed;
+		// How long the command took on the wall clock - core clock ticks, including time spent halted
+		volatile uint32_t elapsedCycles;
+		volatile uint32_t resultCount;
+		std::array<volatile uint32_t, 16> results;
+	};
+	static_assert(sizeof(Mailbox) == 112U);
+
+	extern Mailbox mailbox;
+
+	void initMailbox() noexcept;
+	[[nodiscard]] bool commandPending() noexcept;
+	void beginCommand() noexcept;
+	void completeCommand(Status status, uint32_t elapsedCycles) noexcept;
+	// Append a result value to the mailbox for the command being run (a no-op outside resident mode)
+	void postResult(uint32_t value) noexcept;
+} // namespace semihosting::resident
+
+#endif /*MAILBOX_HXX*/
@@ -0,0 +1,274 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libopencm3/cm3/mpu.h>
+#include <libopencm3/cm3/scb.h>
+#include "mappedFile.hxx"
+#include "arena.hxx"
+#include "syscalls.hxx"
+#include "wallClock.hxx"
+
+using semihosting::types::OpenMode;
+using semihosting::types::SemihostingResult;
+
+namespace semihosting::memory
+{
+	// The highest numbered regions, so the mapping takes priority over any others that overlap the window
+	constexpr static uint32_t noAccessRegion{6U};
+	constexpr static uint32_t readOnlyRegion{7U};
+	constexpr static uint32_t windowSizeLog2{13U};
+	static_assert((1U << windowSizeLog2) == MappedFile::windowSize);
+	constexpr static uint32_t regionSize{(windowSizeLog2 - 1U) << MPU_RASR_SIZE_LSB};
+	// Normal, shareable, write-through memory like the rest of SRAM, that must never be executed from
+	constexpr static uint32_t regionAttributes{MPU_RASR_ATTR_XN | MPU_RASR_ATTR_S | MPU_RASR_ATTR_C};
+
+	static MappedFile *activeMapping{nullptr};
+
+	MappedFile::MappedFile(const std::string_view fileName, const bool writable) noexcept : _writable{writable}
+	{
+		if (activeMapping || !(MPU_TYPE & 0xff00U))
+			return;
+		_fd = semihosting::open(fileName, writable ? OpenMode::readBinaryPlus : OpenMode::readBinary);
+		if (_fd == -1)
+			return;
+		const auto fileLength{semihosting::fileLength(_fd)};
+		// An MPU region must be aligned to its own size
+		auto *const window{static_cast<uint8_t *>(arena.allocate(windowSize, windowSize))};
+		if (fileLength == -1 || !window)
+		{
+			static_cast<void>(semihosting::close(_fd));
+			_fd = -1;
+			return;
+		}
+		_fileLength = static_cast<uint32_t>(fileLength);
+		_window = window;
+		activeMapping = this;
+
+		updateProtection();
+		// Leave the default memory map in place for everything outside our regions, and route MPU
+		// violations to MemManage rather than letting them escalate to HardFault
+		MPU_CTRL = MPU_CTRL_ENABLE | MPU_CTRL_PRIVDEFENA;
+		SCB_SHCSR = SCB_SHCSR | SCB_SHCSR_MEMFAULTENA;
+		__asm__ volatile("dsb\n\tisb" ::: "memory");
+	}
+
+	MappedFile::~MappedFile() noexcept
+	{
+		if (!valid())
+			return;
+		static_cast<void>(sync());
+		// Hand the window back to the arena as ordinary memory
+		MPU_RNR = noAccessRegion;
+		MPU_RASR = 0U;
+		MPU_RNR = readOnlyRegion;
+		MPU_RASR = 0U;
+		__asm__ volatile("dsb\n\tisb" ::: "memory");
+		activeMapping = nullptr;
+		static_cast<void>(semihosting::close(_fd));
+	}
+
+	substrate::span<uint8_t> MappedFile::data() const noexcept
+	{
+		if (!valid() || _offset >= _fileLength)
+			return {};
+		const auto remaining{_fileLength - _offset};
+		return {_window, remaining < windowSize ? remaining : windowSize};
+	}
+
+	void MappedFile::updateProtection() const noexcept
+	{
+		const auto base{reinterpret_cast<uintptr_t>(_window)};
+		// Pages that are not resident can't be touched at all - resident ones are holes in this region
+		MPU_RNR = noAccessRegion;
+		MPU_RBAR = base;
+		MPU_RASR = _residentPages == 0xffU ? 0U : regionAttributes | MPU_RASR_ATTR_AP_PNO_UNO |
+			(uint32_t{_residentPages} << MPU_RASR_SRD_LSB) | regionSize | MPU_RASR_ENABLE;
+		// Resident pages that have not been written to yet are read-only - everything else is a hole in this one
+		const uint8_t cleanPages(_residentPages & ~_dirtyPages);
+		MPU_RNR = readOnlyRegion;
+		MPU_RBAR = base;
+		MPU_RASR = !cleanPages ? 0U : regionAttributes | MPU_RASR_ATTR_AP_PRO_UNO |
+			(uint32_t{uint8_t(~cleanPages)} << MPU_RASR_SRD_LSB) | regionSize | MPU_RASR_ENABLE;
+		__asm__ volatile("dsb\n\tisb" ::: "memory");
+	}
+
+	void MappedFile::touch(const size_t page) noexcept
+		{ _lastTouched[page] = ++_touchClock; }
+
+	bool MappedFile::pageIn(const size_t page) noexcept
+	{
+		const auto start{wallClock::now()};
+		const uint8_t pageBit(1U << page);
+		// Open the page right up while we fill it, as zeroing the tail is done by the CPU
+		_residentPages |= pageBit;
+		_dirtyPages |= pageBit;
+		updateProtection();
+
+		const substrate::span<uint8_t> pageData{_window + page * pageSize, pageSize};
+		const auto fileOffset{_offset + page * pageSize};
+		size_t filled{0U};
+		if (fileOffset < _fileLength)
+		{
+			const auto remaining{_fileLength - fileOffset};
+			filled = remaining < pageSize ? remaining : pageSize;
+			// SYS_READ returns the number of bytes *not* read
+			if (semihosting::seek(_fd, fileOffset) != 0 ||
+				semihosting::read(_fd, pageData.subspan(0U, filled)) != 0)
+			{
+				_residentPages &= ~pageBit;
+				_dirtyPages &= ~pageBit;
+				updateProtection();
+				return false;
+			}
+		}
+		// Anything past the end of the file reads as zeroes
+		for (auto &byte : pageData.subspan(filled))
+			byte = 0U;
+
+		_dirtyPages &= ~pageBit;
+		updateProtection();
+		++_stats.pageIns;
+		_stats.transferCycles += wallClock::now() - start;
+		return true;
+	}
+
+	bool MappedFile::writeBack(const size_t page) noexcept
+	{
+		const uint8_t pageBit(1U << page);
+		if (!(_dirtyPages & pageBit))
+			return true;
+		const auto start{wallClock::now()};
+		// Writes to the part of a page past the end of the file are dropped - the file never grows
+		const auto fileOffset{_offset + page * pageSize};
+		if (fileOffset < _fileLength)
+		{
+			const auto remaining{_fileLength - fileOffset};
+			const substrate::span<const uint8_t> pageData{_window + page * pageSize,
+				remaining < pageSize ? remaining : pageSize};
+			// SYS_WRITE returns the number of bytes *not* written
+			if (semihosting::seek(_fd, fileOffset) != 0 || semihosting::write(_fd, pageData) != 0)
+				return false;
+		}
+		_dirtyPages &= ~pageBit;
+		updateProtection();
+		++_stats.writeBacks;
+		_stats.transferCycles += wallClock::now() - start;
+		return true;
+	}
+
+	bool MappedFile::evictOldest() noexcept
+	{
+		size_t oldest{windowPages};
+		for (size_t page{0U}; page < windowPages; ++page)
+		{
+			if ((_residentPages & (1U << page)) &&
+				(oldest == windowPages || _lastTouched[page] < _lastTouched[oldest]))
+				oldest = page;
+		}
+		if (oldest == windowPages || !writeBack(oldest))
+			return false;
+		_residentPages &= ~(1U << oldest);
+		updateProtection();
+		++_stats.evictions;
+		return true;
+	}
+
+	bool MappedFile::sync() noexcept
+	{
+		bool result{true};
+		for (size_t page{0U}; page < windowPages; ++page)
+			result &= writeBack(page);
+		return result;
+	}
+
+	bool MappedFile::slide(const uint32_t offset) noexcept
+	{
+		if (!valid() || !sync())
+			return false;
+		_offset = offset & ~uint32_t(pageSize - 1U);
+		_residentPages = 0U;
+		_dirtyPages = 0U;
+		updateProtection();
+		return true;
+	}
+
+	void MappedFile::residentLimit(const size_t pages) noexcept
+		{ _residentLimit = pages == 0U || pages > windowPages ? windowPages : pages; }
+
+	bool MappedFile::handleFault(const uintptr_t address) noexcept
+	{
+		const auto base{reinterpret_cast<uintptr_t>(_window)};
+		if (address < base || address - base >= windowSize)
+			return false;
+		++_stats.faults;
+		const auto page{(address - base) / pageSize};
+		const uint8_t pageBit(1U << page);
+
+		// First touch of the page - bring it in (making room first if need be)
+		if (!(_residentPages & pageBit))
+		{
+			size_t resident{0U};
+			for (auto pages{_residentPages}; pages; pages &= pages - 1U)
+				++resident;
+			if (resident >= _residentLimit && !evictOldest())
+				return false;
+			touch(page);
+			// If this was a write, retrying it will fault again on the now read-only page and mark it dirty
+			return pageIn(page);
+		}
+		// Resident and not yet dirty, so this must be the first write to it
+		if (!(_dirtyPages & pageBit) && _writable)
+		{
+			touch(page);
+			_dirtyPages |= pageBit;
+			updateProtection();
+			return true;
+		}
+		return false;
+	}
+} // namespace semihosting::memory
+
+using semihosting::memory::activeMapping;
+
+// Resolve faults on the mapped window. Anything else is a genuine fault, so stop for the debugger
+extern "C" void mem_manage_handler()
+{
+	const auto status{SCB_CFSR};
+	if ((status & SCB_CFSR_MMARVALID) && activeMapping && activeMapping->handleFault(SCB_MMFAR))
+	{
+		// The MemManage status bits are the bottom byte of CFSR, and are cleared by writing 1s to them
+		SCB_CFSR = status & 0xffU;
+		return;
+	}
+	while (true)
+		__asm__("bkpt #0");
+}
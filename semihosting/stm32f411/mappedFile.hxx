@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MAPPED_FILE_HXX
+#define MAPPED_FILE_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+#include <substrate/span>
+
+namespace semihosting::memory
+{
+	struct MappedFileStats final
+	{
+		// MemManage faults taken on the window
+		uint32_t faults;
+		// Pages read in from the host
+		uint32_t pageIns;
+		// Dirty pages written back to the host
+		uint32_t writeBacks;
+		// Pages dropped to stay within the resident page limit
+		uint32_t evictions;
+		// Wall clock ticks (at the core clock rate, halts included) spent moving data to and from the host
+		uint64_t transferCycles;
+	};
+
+	/*
+	 * Maps a window of a host file into memory, filling each page from the host only when it is first touched.
+	 * The Cortex-M4 MPU can protect memory but not translate addresses, so the window is a block of SRAM
+	 * (taken from the arena, so it must live inside an ArenaScope) that stands in for windowSize bytes of the
+	 * file starting at offset(). Files larger than the window are worked through by moving the window along
+	 * with slide().
+	 *
+	 * The window is covered by two MPU regions whose subregions are the pages. The lower priority one makes
+	 * non-resident pages inaccessible, so the first touch of one faults and the MemManage handler reads it
+	 * in. The higher priority one makes clean pages read-only, so the first write to one faults and marks it
+	 * dirty, for writing back on sync(), slide(), eviction or destruction. Only one file may be mapped at a time.
+	 */
+	struct MappedFile final
+	{
+	public:
+		// Each page is one MPU subregion, and a region has 8 of them
+		constexpr static size_t windowPages{8U};
+		constexpr static size_t pageSize{1024U};
+		constexpr static size_t windowSize{windowPages * pageSize};
+
+	private:
+		int32_t _fd{-1};
+		bool _writable{false};
+		uint8_t *_window{nullptr};
+		uint32_t _fileLength{0U};
+		uint32_t _offset{0U};
+		// Bitmaps with a bit per page of the window
+		uint8_t _residentPages{0U};
+		uint8_t _dirtyPages{0U};
+		size_t _residentLimit{windowPages};
+		// When each page was last faulted on, for choosing which to evict
+		std::array<uint32_t, windowPages> _lastTouched{};
+		uint32_t _touchClock{0U};
+		MappedFileStats _stats{};
+
+		void updateProtection() const noexcept;
+		[[nodiscard]] bool pageIn(size_t page) noexcept;
+		[[nodiscard]] bool writeBack(size_t page) noexcept;
+		[[nodiscard]] bool evictOldest() noexcept;
+		void touch(size_t page) noexcept;
+
+	public:
+		MappedFile(std::string_view fileName, bool writable) noexcept;
+		MappedFile(const MappedFile &) = delete;
+		MappedFile(MappedFile &&) = delete;
+		~MappedFile() noexcept;
+		MappedFile &operator =(const MappedFile &) = delete;
+		MappedFile &operator =(MappedFile &&) = delete;
+
+		[[nodiscard]] bool valid() const noexcept { return _window != nullptr; }
+		// The part of the window that currently stands in for file contents
+		[[nodiscard]] substrate::span<uint8_t> data() const noexcept;
+		[[nodiscard]] uint32_t offset() const noexcept { return _offset; }
+		[[nodiscard]] uint32_t length() const noexcept { return _fileLength; }
+		[[nodiscard]] const MappedFileStats &stats() const noexcept { return _stats; }
+
+		// Write back any dirty pages, then move the window to cover the file from offset (rounded down to a page)
+		[[nodiscard]] bool slide(uint32_t offset) noexcept;
+		// Write back any dirty pages, leaving them resident
+		[[nodiscard]] bool sync() noexcept;
+		// Limit how many pages may be resident at once, evicting the least recently faulted-in page to make room
+		void residentLimit(size_t pages) noexcept;
+		// The limit in force, after clamping to the window
+		[[nodiscard]] size_t residentLimit() const noexcept { return _residentLimit; }
+
+		// Called from the MemManage handler - returns false if the fault was not one the mapping can resolve
+		[[nodiscard]] bool handleFault(uintptr_t address) noexcept;
+	};
+} // namespace semihosting::memory
+
+#endif /*MAPPED_FILE_HXX*/
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <array>
+#include <libopencm3/cm3/scs.h>
+#include <libopencm3/cm3/dwt.h>
+#include "perfScope.hxx"
+#include "hostConsole.hxx"
+
+using namespace std::literals::string_view_literals;
+namespace semihosting::perf
+{
+	using host::console::host;
+
+	struct Region final
+	{
+		std::string_view name{};
+		uint32_t calls{0U};
+		// How many of those calls were short enough for the event counters to be exact
+		uint32_t eventCalls{0U};
+		// Accumulated as 64-bit so long runs don't wrap the totals
+		uint64_t cycles{0U};
+		uint64_t cpi{0U};
+		uint64_t exception{0U};
+		uint64_t sleep{0U};
+		uint64_t lsu{0U};
+		uint64_t fold{0U};
+	};
+
+	constexpr static size_t maxRegions{32U};
+	constexpr static uint32_t eventCounterMask{0xffU};
+
+	static std::array<Region, maxRegions> regions{};
+	static size_t regionCount{0U};
+	// Regions that could not be tracked because the table was full
+	static uint32_t droppedRegions{0U};
+	// Set while report() runs so the console writes it makes don't alter the numbers being printed
+	static bool reporting{false};
+
+	Counters Counters::read() noexcept
+	{
+		Counters counters{};
+		counters.cycles = DWT_CYCCNT;
+		counters.cpi = DWT_CPICNT;
+		counters.exception = DWT_EXCCNT;
+		counters.sleep = DWT_SLEEPCNT;
+		counters.lsu = DWT_LSUCNT;
+		counters.fold = DWT_FOLDCNT;
+		return counters;
+	}
+
+	Counters Counters::operator -(const Counters &start) const noexcept
+	{
+		Counters delta{};
+		delta.cycles = cycles - start.cycles;
+		delta.cpi = (cpi - start.cpi) & eventCounterMask;
+		delta.exception = (exception - start.exception) & eventCounterMask;
+		delta.sleep = (sleep - start.sleep) & eventCounterMask;
+		delta.lsu = (lsu - start.lsu) & eventCounterMask;
+		delta.fold = (fold - start.fold) & eventCounterMask;
+		return delta;
+	}
+
+	void enableCounters() noexcept
+	{
+		SCS_DEMCR = SCS_DEMCR | SCS_DEMCR_TRCENA;
+		DWT_CTRL = DWT_CTRL | DWT_CTRL_CYCCNTENA | DWT_CTRL_CPIEVTENA | DWT_CTRL_EXCEVTENA | DWT_CTRL_SLEEPEVTENA |
+			DWT_CTRL_LSUEVTENA | DWT_CTRL_FOLDEVTENA;
+	}
+
+	[[nodiscard]] static Region *findRegion(const std::string_view &name) noexcept
+	{
+		for (size_t index{0U}; index < regionCount; ++index)
+		{
+			if (regions[index].name == name)
+				return &regions[index];
+		}
+		if (regionCount == regions.size())
+		{
+			++droppedRegions;
+			return nullptr;
+		}
+		auto &region{regions[regionCount++]};
+		region = {};
+		region.name = name;
+		return &region;
+	}
+
+	PerfScope::~PerfScope() noexcept
+	{
+		// Take the end snapshot before doing any bookkeeping so the lookup isn't counted against the region
+		const auto delta{Counters::read() - _start};
+		if (reporting)
+			return;
+		auto *const region{findRegion(_region)};
+		if (!region)
+			return;
+		++region->calls;
+		region->cycles += delta.cycles;
+		// Past 255 cycles the 8-bit event counters may have wrapped, and there's no telling how many times
+		if (delta.cycles > eventCounterMask)
+			return;
+		++region->eventCalls;
+		region->cpi += delta.cpi;
+		region->exception += delta.exception;
+		region->sleep += delta.sleep;
+		region->lsu += delta.lsu;
+		region->fold += delta.fold;
+	}
+
+	void report() noexcept
+	{
+		reporting = true;
+		for (size_t index{0U}; index < regionCount; ++index)
+		{
+			const auto &region{regions[index]};
+			host.result("perf"sv, region.name, "calls"sv, region.calls);
+			host.result("perf"sv, region.name, "cycles"sv, region.cycles);
+			// The event counter totals only cover the calls short enough to measure them
+			if (!region.eventCalls)
+				continue;
+			host.result("perf"sv, region.name, "eventCalls"sv, region.eventCalls);
+			host.result("perf"sv, region.name, "cpiCycles"sv, region.cpi);
+			host.result("perf"sv, region.name, "exceptionCycles"sv, region.exception);
+			host.result("perf"sv, region.name, "sleepCycles"sv, region.sleep);
+			host.result("perf"sv, region.name, "lsuCycles"sv, region.lsu);
+			host.result("perf"sv, region.name, "foldedInstructions"sv, region.fold);
+		}
+		if (droppedRegions)
+			host.warn("Profiling region table full, "sv, droppedRegions, " region exits were not recorded"sv);
+		reporting = false;
+	}
+
+	void reset() noexcept
+	{
+		regionCount = 0U;
+		droppedRegions = 0U;
+	}
+} // namespace semihosting::perf
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PERF_SCOPE_HXX
+#define PERF_SCOPE_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace semihosting::perf
+{
+	// A snapshot of every DWT profiling counter. CYCCNT is 32-bit, the rest are 8-bit and wrap, so their
+	// deltas are taken modulo 256. Each event counter moves at most once a cycle, so they are exact for any
+	// region of fewer than 256 cycles - and meaningless past that, so regions only accumulate them from
+	// passes short enough to be exact. None of the counters advance while the core is halted, so time spent
+	// by the host servicing a semihosting call is not included.
+	struct Counters final
+	{
+		uint32_t cycles{0U};
+		uint32_t cpi{0U};
+		uint32_t exception{0U};
+		uint32_t sleep{0U};
+		uint32_t lsu{0U};
+		uint32_t fold{0U};
+
+		[[nodiscard]] static Counters read() noexcept;
+		[[nodiscard]] Counters operator -(const Counters &start) const noexcept;
+	};
+
+	// Turn on the DWT cycle counter and all the event counters
+	void enableCounters() noexcept;
+
+	// Snapshots the DWT counters on construction and destruction, attributing the difference to the named
+	// region. Regions nest, and each one is inclusive of any scopes opened inside it. The name must outlive
+	// the run (a string literal, or a test's name), as the region table keeps a view of it.
+	struct PerfScope final
+	{
+	private:
+		std::string_view _region;
+		Counters _start;
+
+	public:
+		PerfScope(std::string_view region) noexcept : _region{region}, _start{Counters::read()} { }
+		PerfScope(const PerfScope &) = delete;
+		PerfScope(PerfScope &&) = delete;
+		~PerfScope() noexcept;
+		PerfScope &operator =(const PerfScope &) = delete;
+		PerfScope &operator =(PerfScope &&) = delete;
+	};
+
+	// Write a summary of every region seen to the host console as benchmark result lines
+	void report() noexcept;
+	// Forget everything accumulated so far
+	void reset() noexcept;
+} // namespace semihosting::perf
+
+#endif /*PERF_SCOPE_HXX*/
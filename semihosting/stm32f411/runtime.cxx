@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * The handful of C library and C++ ABI pieces the firmware and compiler-generated code need, so the image
+ * links without newlib. The copy and fill loops are built with loop pattern recognition turned off, as
+ * otherwise the compiler would happily turn them back into calls to themselves.
+ */
+#define RUNTIME_FUNC gnu::optimize("no-tree-loop-distribute-patterns"), gnu::used
+
+[[nodiscard]] static bool wordAligned(const void *const pointer) noexcept
+	{ return (reinterpret_cast<uintptr_t>(pointer) & 3U) == 0U; }
+
+extern "C"
+{
+	[[RUNTIME_FUNC]] void *memcpy(void *const destPtr, const void *const srcPtr, size_t length) noexcept
+	{
+		auto *dest{static_cast<uint8_t *>(destPtr)};
+		const auto *src{static_cast<const uint8_t *>(srcPtr)};
+		// When both ends are word aligned, move as much as possible a word at a time
+		if (wordAligned(dest) && wordAligned(src))
+		{
+			for (; length >= 4U; length -= 4U, dest += 4U, src += 4U)
+				*reinterpret_cast<uint32_t *>(dest) = *reinterpret_cast<const uint32_t *>(src);
+		}
+		for (; length; --length)
+			*dest++ = *src++;
+		return destPtr;
+	}
+
+	[[RUNTIME_FUNC]] void *memmove(void *const destPtr, const void *const srcPtr, size_t length) noexcept
+	{
+		auto *dest{static_cast<uint8_t *>(destPtr)};
+		const auto *src{static_cast<const uint8_t *>(srcPtr)};
+		// If the destination starts before the source, a forwards copy never overwrites bytes still to be read
+		if (dest <= src || dest >= src + length)
+			return memcpy(destPtr, srcPtr, length);
+		while (length--)
+			dest[length] = src[length];
+		return destPtr;
+	}
+
+	[[RUNTIME_FUNC]] void *memset(void *const destPtr, const int value, size_t length) noexcept
+	{
+		auto *dest{static_cast<uint8_t *>(destPtr)};
+		const auto byte{static_cast<uint8_t>(value)};
+		for (; length && !wordAligned(dest); --length)
+			*dest++ = byte;
+		const auto word{uint32_t{byte} * 0x01010101U};
+		for (; length >= 4U; length -= 4U, dest += 4U)
+			*reinterpret_cast<uint32_t *>(dest) = word;
+		for (; length; --length)
+			*dest++ = byte;
+		return destPtr;
+	}
+
+	[[RUNTIME_FUNC]] int memcmp(const void *const lhsPtr, const void *const rhsPtr, const size_t length) noexcept
+	{
+		const auto *lhs{static_cast<const uint8_t *>(lhsPtr)};
+		const auto *rhs{static_cast<const uint8_t *>(rhsPtr)};
+		for (size_t index{0U}; index < length; ++index)
+		{
+			if (lhs[index] != rhs[index])
+				return lhs[index] - rhs[index];
+		}
+		return 0;
+	}
+
+	[[RUNTIME_FUNC]] size_t strlen(const char *const string) noexcept
+	{
+		size_t length{0U};
+		while (string[length])
+			++length;
+		return length;
+	}
+
+	// The firmware never exits, so there is nothing to run static destructors at - don't bother recording them
+	/* NOLINTBEGIN(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+	void *__dso_handle{nullptr};
+
+	int __cxa_atexit(void (*)(void *), void *, void *) noexcept
+		{ return 0; }
+
+	// Called if a pure virtual function is somehow reached - there's no sensible recovery, so stop here
+	[[noreturn]] void __cxa_pure_virtual() noexcept
+	{
+		while (true)
+			__asm__("bkpt #0");
+	}
+	/* NOLINTEND(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+}
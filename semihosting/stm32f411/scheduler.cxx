@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <array>
+#include "scheduler.hxx"
+#include "arena.hxx"
+#include "ramfunc.hxx"
+
+namespace semihosting::scheduler
+{
+	struct TaskSlot final
+	{
+		// The coroutine to resume next - the task itself or whatever it is currently co_await'ing
+		std::coroutine_handle<> next{};
+		// If non-zero, the timer whose update flag next is waiting on
+		uint32_t timer{0U};
+		// How many ticks before that timer's update to stop starting other tasks' steps
+		uint32_t guard{0U};
+	};
+
+	constexpr static size_t maxTasks{4U};
+	static TaskSlot *currentSlot{nullptr};
+
+	void *Task::promise_type::operator new(const size_t size) noexcept
+		{ return memory::arena.allocate(size); }
+
+	void internal::suspendCurrent(const std::coroutine_handle<> handle, const uint32_t timer,
+		const uint32_t guard) noexcept
+	{
+		currentSlot->next = handle;
+		currentSlot->timer = timer;
+		currentSlot->guard = guard;
+	}
+
+	// Pick the next slot to run - any whose timer has fired first, otherwise the next ready one after `last`
+	// unless a timer is about to fire that something wants to see promptly
+	[[RAMFUNC]] static size_t nextSlot(const substrate::span<TaskSlot> slots, const size_t last) noexcept
+	{
+		while (true)
+		{
+			bool holdOff{false};
+			for (size_t index{0U}; index < slots.size(); ++index)
+			{
+				const auto &slot{slots[index]};
+				if (!slot.next || !slot.timer)
+					continue;
+				if (TIM_SR(slot.timer) & TIM_SR_UIF)
+					return index;
+				if (TIM_ARR(slot.timer) - TIM_CNT(slot.timer) < slot.guard)
+					holdOff = true;
+			}
+			if (holdOff)
+				continue;
+			for (size_t offset{1U}; offset <= slots.size(); ++offset)
+			{
+				const auto index{(last + offset) % slots.size()};
+				const auto &slot{slots[index]};
+				if (slot.next && !slot.timer)
+					return index;
+			}
+		}
+	}
+
+	bool runConcurrently(const substrate::span<Task> tasks) noexcept
+	{
+		if (tasks.size() > maxTasks)
+			return false;
+		std::array<TaskSlot, maxTasks> slotStorage{};
+		const substrate::span<TaskSlot> slots{slotStorage.data(), tasks.size()};
+		size_t running{0U};
+		for (size_t index{0U}; index < tasks.size(); ++index)
+		{
+			if (!tasks[index].valid())
+				continue;
+			slots[index].next = tasks[index].handle();
+			++running;
+		}
+
+		auto *const previousSlot{currentSlot};
+		size_t last{slots.size() - 1U};
+		while (running)
+		{
+			last = nextSlot(slots, last);
+			auto &slot{slots[last]};
+			const auto handle{slot.next};
+			slot.next = {};
+			slot.timer = 0U;
+			slot.guard = 0U;
+			currentSlot = &slot;
+			handle.resume();
+			if (tasks[last].done())
+				--running;
+		}
+		currentSlot = previousSlot;
+
+		bool result{true};
+		for (const auto &task : tasks)
+			result &= task.result();
+		return result;
+	}
+
+	bool runToCompletion(Task task) noexcept
+		{ return runConcurrently({&task, 1U}); }
+} // namespace semihosting::scheduler
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SCHEDULER_HXX
+#define SCHEDULER_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <coroutine>
+#include <substrate/span>
+#include <libopencm3/stm32/timer.h>
+
+namespace semihosting::scheduler
+{
+	// A coroutine that produces a pass/fail result. Tasks start suspended and are run either by the scheduler
+	// (runConcurrently(), runToCompletion()) or by another task co_await'ing them, which runs the awaited task
+	// to completion (including any suspensions) before resuming the awaiter with its result.
+	struct [[nodiscard]] Task final
+	{
+		struct promise_type;
+		using handle_t = std::coroutine_handle<promise_type>;
+
+		struct FinalAwaiter final
+		{
+			[[nodiscard]] bool await_ready() const noexcept { return false; }
+			// Hand control back to whatever co_await'd this task, or to the scheduler if nothing did
+			[[nodiscard]] std::coroutine_handle<> await_suspend(const handle_t handle) const noexcept
+			{
+				const auto continuation{handle.promise().continuation};
+				return continuation ? continuation : std::noop_coroutine();
+			}
+			void await_resume() const noexcept { }
+		};
+
+		struct promise_type final
+		{
+			bool result{false};
+			std::coroutine_handle<> continuation{};
+
+			// Frames come out of the arena, so they are freed in bulk when the enclosing ArenaScope ends
+			[[nodiscard]] static void *operator new(size_t size) noexcept;
+			static void operator delete(void *, size_t) noexcept { }
+			[[nodiscard]] static Task get_return_object_on_allocation_failure() noexcept { return {}; }
+
+			[[nodiscard]] Task get_return_object() noexcept { return Task{handle_t::from_promise(*this)}; }
+			[[nodiscard]] std::suspend_always initial_suspend() const noexcept { return {}; }
+			[[nodiscard]] FinalAwaiter final_suspend() const noexcept { return {}; }
+			void return_value(const bool value) noexcept { result = value; }
+			void unhandled_exception() const noexcept { }
+		};
+
+	private:
+		handle_t _handle{};
+
+		explicit Task(const handle_t handle) noexcept : _handle{handle} { }
+
+	public:
+		Task() noexcept = default;
+		Task(const Task &) = delete;
+		Task(Task &&other) noexcept : _handle{other._handle} { other._handle = {}; }
+		~Task() noexcept
+		{
+			if (_handle)
+				_handle.destroy();
+		}
+		Task &operator =(const Task &) = delete;
+		Task &operator =(Task &&other) noexcept
+		{
+			if (_handle)
+				_handle.destroy();
+			_handle = other._handle;
+			other._handle = {};
+			return *this;
+		}
+
+		// A task whose frame could not be allocated is never valid, and counts as failed
+		[[nodiscard]] bool valid() const noexcept { return static_cast<bool>(_handle); }
+		[[nodiscard]] bool done() const noexcept { return !_handle || _handle.done(); }
+		[[nodiscard]] bool result() const noexcept { return _handle && _handle.done() && _handle.promise().result; }
+		[[nodiscard]] handle_t handle() const noexcept { return _handle; }
+
+		[[nodiscard]] bool await_ready() const noexcept { return !_handle; }
+		[[nodiscard]] std::coroutine_handle<> await_suspend(const std::coroutine_handle<> awaiter) const noexcept
+		{
+			_handle.promise().continuation = awaiter;
+			return _handle;
+		}
+		[[nodiscard]] bool await_resume() const noexcept { return result(); }
+	};
+
+	namespace internal
+	{
+		// Park the suspended coroutine in the running task's slot, ready to be resumed - or, if timer is not
+		// 0, resumed once that timer's update flag is set, holding off other work for the last guard ticks
+		void suspendCurrent(std::coroutine_handle<> handle, uint32_t timer, uint32_t guard) noexcept;
+	} // namespace internal
+
+	// Give the other tasks a turn
+	struct Yield final
+	{
+		[[nodiscard]] bool await_ready() const noexcept { return false; }
+		void await_suspend(const std::coroutine_handle<> handle) const noexcept
+			{ internal::suspendCurrent(handle, 0U, 0U); }
+		void await_resume() const noexcept { }
+	};
+
+	// Wait for a timer's update flag to be set, clearing it again on resumption. Another task's step can't be
+	// cut short once started, so a waiter that has to act promptly on the update sets guard - once the timer
+	// is within that many ticks of its update no other task is started, and the wait becomes a spin. The
+	// result is how many ticks the timer had counted past the update by the time we resumed.
+	struct TimerUpdate final
+	{
+		uint32_t timer;
+		uint32_t guard{0U};
+
+		[[nodiscard]] bool await_ready() const noexcept { return TIM_SR(timer) & TIM_SR_UIF; }
+		void await_suspend(const std::coroutine_handle<> handle) const noexcept
+			{ internal::suspendCurrent(handle, timer, guard); }
+		uint32_t await_resume() const noexcept
+		{
+			TIM_SR(timer) = ~TIM_SR_UIF;
+			return TIM_CNT(timer);
+		}
+	};
+
+	// Run all the tasks until every one has finished, returning true only if they all passed. Waits on timer
+	// deadlines take priority over other ready work so they are resumed as soon as possible after firing,
+	// and no other work is started inside a waiter's guard window.
+	[[nodiscard]] bool runConcurrently(substrate::span<Task> tasks) noexcept;
+	[[nodiscard]] bool runToCompletion(Task task) noexcept;
+} // namespace semihosting::scheduler
+
+#endif /*SCHEDULER_HXX*/
@@ -31,14 +31,35 @@
  */
 
 #include <array>
+#include <algorithm>
+#include <optional>
 #include <string_view>
 #include <substrate/span>
 #include <substrate/index_sequence>
-#include <frozen/unordered_map.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/cm3/dwt.h>
 #include "syscalls.hxx"
 #include "hostConsole.hxx"
+#include "mailbox.hxx"
+#include "arena.hxx"
+#include "stackUsage.hxx"
+#include "perfScope.hxx"
+#include "inputReader.hxx"
+#include "logQueue.hxx"
+#include "ramfunc.hxx"
+#include "scheduler.hxx"
+#include "soak.hxx"
+#include "irqLoad.hxx"
+#include "mappedFile.hxx"
+#include "busLoad.hxx"
+#include "batch.hxx"
+#include "statistics.hxx"
+#include "wallClock.hxx"
+#ifdef SEMIHOSTING_TRACE
+#include "trace.hxx"
+#endif
 
 using namespace std::literals::string_view_literals;
 using semihosting::types::OpenMode;
@@ -46,7 +67,21 @@ using semihosting::types::HeapInfoBlock;
 using semihosting::types::SemihostingResult;
 using semihosting::types::FileIOErrno;
 using semihosting::types::ExitReason;
+using semihosting::types::enumName;
+using semihosting::types::enumDescription;
 using semihosting::host::console::host;
+using semihosting::host::console::InputReader;
+using semihosting::host::console::logQueue;
+using semihosting::resident::mailbox;
+namespace resident = semihosting::resident;
+namespace soak = semihosting::soak;
+using semihosting::memory::arena;
+using semihosting::memory::ArenaScope;
+using semihosting::memory::MappedFile;
+using semihosting::scheduler::Task;
+using semihosting::scheduler::Yield;
+using semihosting::scheduler::TimerUpdate;
+using semihosting::statistics::Summary;
 
 constexpr static int32_t stdinFD{1};
 constexpr static int32_t stdoutFD{2};
@@ -57,34 +92,54 @@ constexpr static auto alphabet{"abcdefghijklmnopqrstuvwxyz\r\n"sv};
 constexpr static auto testFileA{"semihosting-test.a"sv};
 constexpr static auto testFileB{"semihosting-test.b"sv};
 constexpr static auto testTempFileName{"tempAK.tmp"sv};
+constexpr static auto testThroughputFile{"semihosting-throughput.bin"sv};
+constexpr static auto testMappedFile{"semihosting-mapped.bin"sv};
+constexpr static auto testBatchFile{"semihosting-batch.bin"sv};
+constexpr static auto testFDFilePrefix{"semihosting-fd."sv};
+constexpr static size_t fdFileNameLength{testFDFilePrefix.length() + 4U};
 
-constexpr static auto fileIOErrno
-{
-	frozen::make_unordered_map<FileIOErrno, std::string_view>
-	({
-		{FileIOErrno::notPermitted, "FILEIO_EPERM (Operation not permitted)"sv},
-		{FileIOErrno::noSuchEntity, "FILEIO_ENOENT (No such file or directory)"sv},
-		{FileIOErrno::syscallInterrupted, "FILEIO_EINTR (Interrupted system call)"sv},
-		{FileIOErrno::ioError, "FILEIO_EIO (I/O error)"sv},
-		{FileIOErrno::badFD, "FILEIO_EBADF (Bad file number)"sv},
-		{FileIOErrno::accessError, "FILEIO_EACCESS (Permission denied)"sv},
-		{FileIOErrno::addressFault, "FILEIO_EFAULT (Bad address)"sv},
-		{FileIOErrno::busy, "FILEIO_EBUSY (Device or resource busy)"sv},
-		{FileIOErrno::alreadyExists, "FILEIO_EEXIST (File already exists)"sv},
-		{FileIOErrno::noSuchDevice, "FILEIO_ENODEV (No such device)"sv},
-		{FileIOErrno::notADir, "FILEIO_ENOTDIR (Not a directory)"sv},
-		{FileIOErrno::isADir, "FILEIO_EISDIR (Is a directory)"sv},
-		{FileIOErrno::argumentInvalid, "FILEIO_EINVAL (Invalid argument)"sv},
-		{FileIOErrno::fileTableFull, "FILEIO_ENFILE (File table overflow)"sv},
-		{FileIOErrno::tooManyOpenFiles, "FILEIO_EMFILE (Too many open files)"sv},
-		{FileIOErrno::fileTooLarge, "FILENO_EFBIG (File too large)"sv},
-		{FileIOErrno::outOfSpace, "FILENO_ENOSPC (No space left on device)"sv},
-		{FileIOErrno::illegalSeek, "FILENO_ESPIPE (Illegal seek)"sv},
-		{FileIOErrno::fsReadOnly, "FILENO_EROFS (Read-only file system"sv},
-		{FileIOErrno::syscallInvalid, "FILENO_ENOSYS (Invalid system call number)"sv},
-		{FileIOErrno::fileNameTooLong, "FILENO_ENAMETOOLONG (File name too long)"sv},
-	})
-};
+// The most files we will try to hold open at once by default before giving up on finding the host's limit
+constexpr static size_t maxConcurrentFDs{1024U};
+// How many times the file throughput benchmark writes and reads back its buffer by default
+constexpr static uint32_t defaultThroughputPasses{4U};
+// Default size of the file the mapped file benchmark works through - twice the size of SRAM
+constexpr static uint32_t defaultMappedFileSize{256U * 1024U};
+// How many of the first SYS_OPEN calls in the FD scaling test are used to form the latency baseline
+constexpr static size_t fdBaselineOpens{8U};
+// How many times slower than the baseline SYS_OPEN may get before the handle table is considered to not scale
+constexpr static uint64_t fdLatencyGrowthLimit{2U};
+// How many opens apart the FD scaling test samples per-operation latency, on top of every power of two
+constexpr static size_t fdSampleInterval{32U};
+// How long before TIM1's update the timekeeping tests stop anything overlapped from starting, in TIM1 ticks
+// (100ms) - long enough for any one background step, so the host is asked for the time as the timer fires
+constexpr static uint32_t hostReadGuard{200U};
+// How many times the flash vs RAM benchmark runs its workload by default
+constexpr static uint32_t defaultWorkloadIterations{10000U};
+// How many runs of the suite a soak run does between each summary of the results so far
+constexpr static uint32_t soakReportInterval{100U};
+// How many times the batched IO benchmark repeats each way of writing its file by default
+constexpr static uint32_t defaultBatchIterations{16U};
+// How long the bus contention benchmark holds the bus load on for by default, in milliseconds
+constexpr static uint32_t defaultBusContentionTime{1000U};
+// The burst size the bus contention benchmark uses by default
+constexpr static uint8_t defaultBusContentionBurst{4U};
+#if defined(INTERRUPT_LOAD_MODE) && !defined(INTERRUPT_LOAD_RATE)
+// The default interrupt rate for the background load, in Hz
+#define INTERRUPT_LOAD_RATE 100000U
+#endif
+#ifdef BUS_LOAD_MODE
+#ifndef BUS_LOAD_PRIORITY
+// The default DMA priority for the background bus load - 0 (low) through 3 (very high)
+#define BUS_LOAD_PRIORITY 3U
+#endif
+#ifndef BUS_LOAD_BURST
+// The default number of beats per DMA burst for the background bus load
+#define BUS_LOAD_BURST 4U
+#endif
+static_assert(BUS_LOAD_PRIORITY <= 3U, "BUS_LOAD_PRIORITY must be between 0 and 3");
+static_assert(BUS_LOAD_BURST == 1U || BUS_LOAD_BURST == 4U || BUS_LOAD_BURST == 8U || BUS_LOAD_BURST == 16U,
+	"BUS_LOAD_BURST must be one of 1, 4, 8 or 16");
+#endif
 
 // NB: This suite is incomplete in that it does *not* test SYS_READ and SYS_READC with stdin
 // This is because we cannot write a reproducible easy to use test. We assume that SYS_READC
@@ -101,6 +156,22 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	return N;
 }
 
+// Generate the name of the `index`th file used in the FD scaling test into `storage` as `semihosting-fd.NNNN`
+template<size_t N> [[nodiscard]] static std::string_view fdTestFileName(std::array<char, N> &storage,
+	size_t index) noexcept
+{
+	static_assert(N >= fdFileNameLength);
+	size_t offset{0U};
+	for (const auto chr : testFDFilePrefix)
+		storage[offset++] = chr;
+	for (size_t digit{4U}; digit; --digit)
+	{
+		storage[offset + digit - 1U] = static_cast<char>('0' + (index % 10U));
+		index /= 10U;
+	}
+	return {storage.data(), offset + 4U};
+}
+
 // Test the retrieval of the command line from GDB
 [[nodiscard]] static bool testReadCommandLine() noexcept
 {
@@ -176,7 +247,9 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	// Now try to check how long the file is and make sure it's the correct length for BMD
 	host.info("Trying SYS_FLEN on "sv, "':semihosting-features'"sv);
 	const auto fileLength{semihosting::fileLength(featuresFD)};
-	if (static_cast<size_t>(fileLength) != featuresLength)
+	// A debugger offering the batch extension adds the byte its feature bit lives in
+	const auto extendedFeatures{static_cast<size_t>(fileLength) == featuresLength + semihosting::types::featureBatchByte};
+	if (static_cast<size_t>(fileLength) != featuresLength && !extendedFeatures)
 	{
 		host.error("SYS_FLEN failed, file "sv, fileLength == -1 ? "length couldn't be determined"sv : "too short"sv);
 		if (semihosting::close(featuresFD) != SemihostingResult::success)
@@ -224,6 +297,19 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 		return false;
 	}
 	host.notice("Supported features reported correctly"sv);
+	if (extendedFeatures)
+	{
+		// If the extra byte is there, the batch extension is the only thing it can say is supported
+		uint8_t vendorFeatures{};
+		if (semihosting::read(featuresFD, {&vendorFeatures, 1U}) != 0 ||
+			vendorFeatures != semihosting::types::featureBatch)
+		{
+			host.error("Vendor features byte could not be read or has incorrect value "sv, vendorFeatures);
+			static_cast<void>(semihosting::close(featuresFD));
+			return false;
+		}
+		host.notice("Batched operations supported"sv);
+	}
 
 	host.info("Trying SYS_CLOSE on "sv, "':semihosting-features'"sv);
 	// Now try to close the "file" handle to make sure nothing bad happens in the emulation
@@ -378,34 +464,601 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	return true;
 }
 
-[[nodiscard]] static bool testIsError() noexcept
+// Storage for the handles held open by the FD scaling test, allocated from the arena for the duration of the test
+static substrate::span<int32_t> concurrentFDs{};
+
+// Close and remove the first `count` files opened by the FD scaling test. A handle of -1 is one that
+// could not be reopened, so there's only its file left to remove
+[[nodiscard]] static bool cleanupFileHandles(const size_t count) noexcept
+{
+	std::array<char, fdFileNameLength> fileNameBuffer{};
+	bool result{true};
+	for (const auto index : substrate::indexSequence_t{count})
+	{
+		const auto fd{concurrentFDs[index]};
+		if ((fd != -1 && semihosting::close(fd) != SemihostingResult::success) ||
+			semihosting::remove(fdTestFileName(fileNameBuffer, index)) != SemihostingResult::success)
+			result = false;
+		// Each of these is two halts, and there may be a thousand of them, so keep the soak watchdog fed
+		soak::feedWatchdog();
+	}
+	if (!result)
+		host.error("Failed to clean up the FD scaling test files"sv);
+	return result;
+}
+
+// Time write, read, and close+reopen on the most recently opened handle at a given FD count. These are
+// timed on the wall clock as the DWT cycle counter stops while the host services the call
+[[nodiscard]] static bool timeFileHandleOperations(const size_t count) noexcept
+{
+	std::array<char, fdFileNameLength> fileNameBuffer{};
+	std::array<char, alphabet.length()> buffer{};
+	auto &fd{concurrentFDs[count - 1U]};
+
+	auto start{semihosting::wallClock::now()};
+	const auto writeResult{semihosting::write(fd, substrate::span{alphabet})};
+	const auto writeCycles{semihosting::wallClock::now() - start};
+	if (writeResult != 0 || semihosting::seek(fd, 0U) != 0)
+	{
+		host.error("SYS_WRITE failed with "sv, count, " files open"sv);
+		return false;
+	}
+
+	start = semihosting::wallClock::now();
+	const auto readResult{semihosting::read(fd, substrate::span{buffer})};
+	const auto readCycles{semihosting::wallClock::now() - start};
+	if (readResult != 0 || std::string_view{buffer.data(), buffer.size()} != alphabet)
+	{
+		host.error("SYS_READ failed with "sv, count, " files open"sv);
+		return false;
+	}
+
+	start = semihosting::wallClock::now();
+	const auto closeResult{semihosting::close(fd)};
+	const auto closeCycles{semihosting::wallClock::now() - start};
+	if (closeResult != SemihostingResult::success)
+	{
+		host.error("SYS_CLOSE failed with "sv, count, " files open"sv);
+		return false;
+	}
+
+	// Put the handle back so the count of open files is unchanged by the measurement
+	start = semihosting::wallClock::now();
+	fd = semihosting::open(fdTestFileName(fileNameBuffer, count - 1U), OpenMode::writeBinaryPlus);
+	const auto openCycles{semihosting::wallClock::now() - start};
+	// NB: this leaves fd as -1, which tells cleanupFileHandles() there's nothing to close
+	if (fd == -1)
+	{
+		host.error("SYS_OPEN failed re-opening a just closed file: errno = "sv, semihosting::lastErrno());
+		return false;
+	}
+
+	host.result("fdScaling"sv, "open"sv, count, openCycles);
+	host.result("fdScaling"sv, "close"sv, count, closeCycles);
+	host.result("fdScaling"sv, "read"sv, count, readCycles);
+	host.result("fdScaling"sv, "write"sv, count, writeCycles);
+	return true;
+}
+
+// Check how the host's handle table copes with increasing numbers (up to maxFDs) of concurrently open
+// files, and that the limit on open files is reported correctly when we hit it
+[[nodiscard]] static bool fileHandleScaling(const size_t requestedFDs) noexcept
+{
+	const ArenaScope scope{arena};
+	concurrentFDs = arena.allocateUpTo<int32_t>(requestedFDs);
+	const auto maxFDs{concurrentFDs.size()};
+	if (!maxFDs)
+	{
+		host.error("Not enough memory to run the FD scaling test"sv);
+		return false;
+	}
+	host.info("Testing SYS_OPEN with up to "sv, maxFDs, " concurrently open files"sv);
+	std::array<char, fdFileNameLength> fileNameBuffer{};
+	uint64_t baselineCycles{0U};
+	uint64_t bandCycles{0U};
+	size_t bandStart{fdBaselineOpens};
+	size_t count{0U};
+	for (; count < maxFDs; ++count)
+	{
+		// Open the next file in "w+b" mode so we can both write and read it back
+		const auto fileName{fdTestFileName(fileNameBuffer, count)};
+		const auto start{semihosting::wallClock::now()};
+		const auto fd{semihosting::open(fileName, OpenMode::writeBinaryPlus)};
+		const auto openCycles{semihosting::wallClock::now() - start};
+		// If the open failed, we've found the host's limit
+		if (fd == -1)
+			break;
+		concurrentFDs[count] = fd;
+		// The watchdog runs on while the host works, so a slow host could otherwise make this look like a hang
+		soak::feedWatchdog();
+
+		// Accumulate the open time, splitting the opens into power-of-two sized bands once past the baseline
+		if (count < fdBaselineOpens)
+			baselineCycles += openCycles;
+		else
+			bandCycles += openCycles;
+		const auto openFDs{count + 1U};
+		const bool powerOfTwo{(openFDs & (openFDs - 1U)) == 0U};
+		// Sample the per-operation latencies at every power of two, and every fdSampleInterval opens between
+		// so the larger counts aren't left with only a handful of points
+		if (!powerOfTwo && openFDs % fdSampleInterval)
+			continue;
+		if (!timeFileHandleOperations(openFDs))
+		{
+			static_cast<void>(cleanupFileHandles(openFDs));
+			return false;
+		}
+		// If we've completed a band past the baseline, check its mean latency against the baseline
+		if (powerOfTwo && openFDs > fdBaselineOpens)
+		{
+			const auto baselineMean{baselineCycles / fdBaselineOpens};
+			const auto bandMean{bandCycles / (openFDs - bandStart)};
+			host.result("fdScaling"sv, "openMean"sv, openFDs, bandMean);
+			if (bandMean > baselineMean * fdLatencyGrowthLimit)
+			{
+				host.error("SYS_OPEN latency degraded to "sv, bandMean, " cycles with "sv, openFDs,
+					" files open, baseline "sv, baselineMean, " cycles"sv);
+				static_cast<void>(cleanupFileHandles(openFDs));
+				return false;
+			}
+			bandStart = openFDs;
+			bandCycles = 0U;
+		}
+	}
+
+	resident::postResult(count);
+	resident::postResult(static_cast<uint32_t>(baselineCycles / fdBaselineOpens));
+	if (count == maxFDs)
+		host.notice("Host accepted "sv, count, " concurrently open files without reaching its limit"sv);
+	else
+	{
+		// Check that the reason the host refused the open is that we ran it out of handles
+		const auto lastError{semihosting::lastErrno()};
+		host.info("Host refused SYS_OPEN with "sv, count, " files open"sv);
+		host.result("fdScaling"sv, "limit"sv, count);
+		if (lastError != FileIOErrno::tooManyOpenFiles && lastError != FileIOErrno::fileTableFull)
+		{
+			host.error("SYS_OPEN failed giving "sv, lastError, " - expected "sv, FileIOErrno::tooManyOpenFiles);
+			static_cast<void>(cleanupFileHandles(count));
+			return false;
+		}
+		host.notice("Open file limit reported correctly"sv);
+	}
+
+	if (!cleanupFileHandles(count))
+		return false;
+	host.notice("SYS_OPEN handle table scaling success"sv);
+	return true;
+}
+
+[[nodiscard]] static bool testFileHandleScaling() noexcept
+{
+	host.warn("-> "sv, __func__);
+	return fileHandleScaling(maxConcurrentFDs);
+}
+
+// Measure SYS_WRITE and SYS_READ throughput to a host file using a buffer of up to maxBufferSize bytes
+// (or as large as the arena allows when 0), written and read back `passes` times. Passes are timed on the
+// wall clock so the time the host spends moving the data counts
+[[nodiscard]] static bool fileThroughput(const size_t maxBufferSize, const uint32_t passes) noexcept
+{
+	const ArenaScope scope{arena};
+	const auto buffer{arena.allocateUpTo<uint8_t>(maxBufferSize ? maxBufferSize : SIZE_MAX)};
+	if (buffer.empty())
+	{
+		host.error("Not enough memory to run the file throughput benchmark"sv);
+		return false;
+	}
+	host.info("Measuring file throughput with a "sv, buffer.size(), " byte buffer"sv);
+	for (const auto index : substrate::indexSequence_t{buffer.size()})
+		buffer[index] = static_cast<uint8_t>(index);
+
+	const auto fd{semihosting::open(testThroughputFile, OpenMode::writeBinaryPlus)};
+	if (fd == -1)
+	{
+		host.error("SYS_OPEN failed: errno = "sv, semihosting::lastErrno());
+		return false;
+	}
+
+	uint64_t writeCycles{0U};
+	Summary writeSummary{};
+	for ([[maybe_unused]] const auto pass : substrate::indexSequence_t{passes})
+	{
+		const auto start{semihosting::wallClock::now()};
+		const auto result{semihosting::write(fd, buffer)};
+		const auto cycles{semihosting::wallClock::now() - start};
+		writeCycles += cycles;
+		writeSummary.add(cycles);
+		soak::feedWatchdog();
+		if (result != 0)
+		{
+			host.error("SYS_WRITE failed"sv);
+			static_cast<void>(semihosting::close(fd));
+			return false;
+		}
+	}
+
+	uint64_t readCycles{0U};
+	Summary readSummary{};
+	bool result{semihosting::seek(fd, 0U) == 0};
+	for ([[maybe_unused]] const auto pass : substrate::indexSequence_t{passes})
+	{
+		const auto start{semihosting::wallClock::now()};
+		result &= semihosting::read(fd, buffer) == 0;
+		const auto cycles{semihosting::wallClock::now() - start};
+		readCycles += cycles;
+		readSummary.add(cycles);
+		soak::feedWatchdog();
+	}
+	if (!result)
+		host.error("SYS_READ failed"sv);
+
+	if (semihosting::close(fd) != SemihostingResult::success ||
+		semihosting::remove(testThroughputFile) != SemihostingResult::success)
+	{
+		host.error("Failed to clean up the throughput test file"sv);
+		return false;
+	}
+	if (!result)
+		return false;
+
+	const uint64_t totalBytes{buffer.size() * uint64_t{passes}};
+	host.result("fileThroughput"sv, "bufferSize"sv, buffer.size());
+	host.result("fileThroughput"sv, "writeCycles"sv, totalBytes, writeCycles);
+	host.result("fileThroughput"sv, "readCycles"sv, totalBytes, readCycles);
+	writeSummary.report("fileThroughput"sv, "writePassCycles"sv);
+	readSummary.report("fileThroughput"sv, "readPassCycles"sv);
+	resident::postResult(buffer.size());
+	resident::postResult(static_cast<uint32_t>(writeCycles / passes));
+	resident::postResult(static_cast<uint32_t>(readCycles / passes));
+	return true;
+}
+
+[[nodiscard]] static uint8_t mappedFilePattern(const uint32_t offset) noexcept
+	{ return static_cast<uint8_t>(offset ^ (offset >> 8U)); }
+
+[[nodiscard]] static bool writeMappedFile(const uint32_t fileSize) noexcept
+{
+	const auto fd{semihosting::open(testMappedFile, OpenMode::writeBinary)};
+	if (fd == -1)
+	{
+		host.error("SYS_OPEN failed: errno = "sv, semihosting::lastErrno());
+		return false;
+	}
+	std::array<uint8_t, 256> chunk{};
+	bool result{true};
+	for (uint32_t offset{0U}; offset < fileSize; offset += chunk.size())
+	{
+		const auto length{std::min<size_t>(chunk.size(), fileSize - offset)};
+		for (const auto index : substrate::indexSequence_t{length})
+			chunk[index] = mappedFilePattern(offset + index);
+		// SYS_WRITE returns the number of bytes *not* written
+		result &= semihosting::write(fd, substrate::span<const uint8_t>{chunk.data(), length}) == 0;
+	}
+	if (semihosting::close(fd) != SemihostingResult::success || !result)
+	{
+		host.error("Failed to write the mapped file benchmark's test file"sv);
+		return false;
+	}
+	return true;
+}
+
+// Read a host file twice the size of SRAM through a MappedFile - every byte, then only one byte in every other
+// page to show only touched pages get transferred - then check writes through the mapping make it to the host.
+// The passes are timed on the wall clock as the page transfers happen while the core is halted
+[[nodiscard]] static bool mappedFileScan(const uint32_t fileSize, const size_t residentLimit) noexcept
+{
+	const ArenaScope scope{arena};
+	if (!writeMappedFile(fileSize))
+		return false;
+
+	bool result{true};
+	uint32_t mismatches{0U};
+	{
+		MappedFile file{testMappedFile, true};
+		if (!file.valid())
+		{
+			host.error("Failed to map "sv, testMappedFile);
+			static_cast<void>(semihosting::remove(testMappedFile));
+			return false;
+		}
+		file.residentLimit(residentLimit);
+
+		const auto scanStart{semihosting::wallClock::now()};
+		for (uint32_t offset{0U}; offset < file.length(); offset += MappedFile::windowSize)
+		{
+			result &= file.slide(offset);
+			const auto data{file.data()};
+			for (const auto index : substrate::indexSequence_t{data.size()})
+				mismatches += data[index] != mappedFilePattern(offset + index);
+		}
+		const auto scanCycles{semihosting::wallClock::now() - scanStart};
+		const auto scanPageIns{file.stats().pageIns};
+
+		const auto sparseStart{semihosting::wallClock::now()};
+		for (uint32_t offset{0U}; offset < file.length(); offset += MappedFile::windowSize)
+		{
+			result &= file.slide(offset);
+			const auto data{file.data()};
+			for (size_t index{0U}; index < data.size(); index += MappedFile::pageSize * 2U)
+				mismatches += data[index] != mappedFilePattern(offset + index);
+		}
+		const auto sparseCycles{semihosting::wallClock::now() - sparseStart};
+		const auto sparsePageIns{file.stats().pageIns - scanPageIns};
+
+		// Invert the first byte of each page in the first window, and write them back
+		result &= file.slide(0U);
+		const auto data{file.data()};
+		for (size_t index{0U}; index < data.size(); index += MappedFile::pageSize)
+			data[index] = static_cast<uint8_t>(~data[index]);
+		result &= file.sync();
+
+		const auto &stats{file.stats()};
+		host.result("mappedFile"sv, "fileSize"sv, file.length());
+		host.result("mappedFile"sv, "residentLimit"sv, file.residentLimit());
+		host.result("mappedFile"sv, "scanCycles"sv, file.length(), scanCycles);
+		host.result("mappedFile"sv, "scanPageIns"sv, scanPageIns);
+		host.result("mappedFile"sv, "sparseCycles"sv, file.length(), sparseCycles);
+		host.result("mappedFile"sv, "sparsePageIns"sv, sparsePageIns);
+		host.result("mappedFile"sv, "faults"sv, stats.faults);
+		host.result("mappedFile"sv, "evictions"sv, stats.evictions);
+		host.result("mappedFile"sv, "writeBacks"sv, stats.writeBacks);
+		host.result("mappedFile"sv, "transferCycles"sv, stats.transferCycles);
+		resident::postResult(scanCycles);
+		resident::postResult(sparseCycles);
+		resident::postResult(stats.faults);
+	}
+
+	// Now read the inverted bytes back directly to check they were written back
+	const auto fd{semihosting::open(testMappedFile, OpenMode::readBinary)};
+	result &= fd != -1;
+	const auto checkLength{std::min<uint32_t>(fileSize, MappedFile::windowSize)};
+	for (uint32_t offset{0U}; fd != -1 && offset < checkLength; offset += MappedFile::pageSize)
+	{
+		std::array<uint8_t, 1> byte{};
+		if (semihosting::seek(fd, offset) != 0 || semihosting::read(fd, byte) != 0)
+			result = false;
+		else
+			mismatches += byte[0] != static_cast<uint8_t>(~mappedFilePattern(offset));
+	}
+	if ((fd != -1 && semihosting::close(fd) != SemihostingResult::success) ||
+		semihosting::remove(testMappedFile) != SemihostingResult::success)
+	{
+		host.error("Failed to clean up the mapped file benchmark's test file"sv);
+		return false;
+	}
+	if (mismatches)
+		host.error("Mapped file contents mismatched in "sv, mismatches, " places"sv);
+	if (!result)
+		host.error("Mapped file paging failed"sv);
+	return result && !mismatches;
+}
+
+// An integer kernel that is small and branchy, so its speed depends mostly on instruction fetch. It is
+// instantiated once in flash and once in SRAM so the two can be compared like for like
+[[gnu::always_inline]] static inline uint32_t executionWorkload(const uint32_t iterations) noexcept
+{
+	uint32_t state{0x6d2b79f5U};
+	uint32_t accumulator{0U};
+	for ([[maybe_unused]] const auto iteration : substrate::indexSequence_t{iterations})
+	{
+		state ^= state << 13U;
+		state ^= state >> 17U;
+		state ^= state << 5U;
+		if (state & 1U)
+			accumulator += state;
+		else
+			accumulator ^= state >> 3U;
+	}
+	return accumulator;
+}
+
+[[gnu::noinline]] static uint32_t executionWorkloadFlash(const uint32_t iterations) noexcept
+	{ return executionWorkload(iterations); }
+
+[[RAMTEXT]] static uint32_t executionWorkloadRAM(const uint32_t iterations) noexcept
+	{ return executionWorkload(iterations); }
+
+struct flashConfig_t final
+{
+	std::string_view name;
+	uint32_t extraWaitStates;
+	bool accelerator;
+};
+
+// Compare the cycles the workload takes from flash and from SRAM, with the ART accelerator (prefetch plus
+// the instruction and data caches) on and off, at both the minimum wait states for 84MHz and 5 more
+[[nodiscard]] static bool flashVsRAM(const uint32_t iterations) noexcept
+{
+	constexpr std::array<flashConfig_t, 4> configs
+	{{
+		{"accelerated"sv, 0U, true},
+		{"unaccelerated"sv, 0U, false},
+		{"acceleratedSlowFlash"sv, 5U, true},
+		{"unacceleratedSlowFlash"sv, 5U, false},
+	}};
+	// 84MHz at 3.3V needs 2 wait states
+	constexpr uint32_t minimumWaitStates{2U};
+	const uint32_t savedFlashConfig{FLASH_ACR};
+
+	bool result{true};
+	for (const auto &config : configs)
+	{
+		flash_prefetch_disable();
+		flash_icache_disable();
+		flash_dcache_disable();
+		flash_set_ws(minimumWaitStates + config.extraWaitStates);
+		if (config.accelerator)
+		{
+			// The caches must be reset while disabled so every run starts cold
+			flash_icache_reset();
+			flash_dcache_reset();
+			FLASH_ACR = FLASH_ACR & ~(FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+			flash_icache_enable();
+			flash_dcache_enable();
+			flash_prefetch_enable();
+		}
+
+		const auto flashStart{dwt_read_cycle_counter()};
+		const auto flashResult{executionWorkloadFlash(iterations)};
+		const auto flashCycles{dwt_read_cycle_counter() - flashStart};
+		const auto ramStart{dwt_read_cycle_counter()};
+		const auto ramResult{executionWorkloadRAM(iterations)};
+		const auto ramCycles{dwt_read_cycle_counter() - ramStart};
+
+		// Put the flash back how it was before talking to the host
+		FLASH_ACR = savedFlashConfig;
+		if (flashResult != ramResult)
+		{
+			host.error("Flash and RAM copies of the workload disagree ("sv, flashResult, " vs "sv, ramResult, ")"sv);
+			result = false;
+			continue;
+		}
+		host.result("flashVsRAM"sv, config.name, "flashCycles"sv, iterations, flashCycles);
+		host.result("flashVsRAM"sv, config.name, "ramCycles"sv, iterations, ramCycles);
+		resident::postResult(flashCycles);
+		resident::postResult(ramCycles);
+	}
+	return result;
+}
+
+// Hold the bus under DMA load for `milliseconds`, doing nothing on the core meanwhile so that the only other
+// bus master is the debug probe - the host measures its own memory access throughput while this is running
+[[nodiscard]] static bool busContention(const uint32_t milliseconds, const uint32_t priority, const uint8_t burst)
+	noexcept
+{
+	using semihosting::busLoad::Priority;
+	// If the firmware was built to run under a bus load, put it back how it was afterwards
+	const auto wasRunning{semihosting::busLoad::running()};
+	const auto previousConfig{semihosting::busLoad::config()};
+	if (priority > static_cast<uint32_t>(Priority::veryHigh) ||
+		!semihosting::busLoad::start({static_cast<Priority>(priority), burst}))
+	{
+		host.error("Invalid bus load configuration (priority "sv, priority, ", burst "sv, burst, ")"sv);
+		return false;
+	}
+
+	host.notice("Bus load running for "sv, milliseconds, "ms"sv);
+	const auto before{semihosting::busLoad::snapshot()};
+	// Wait a millisecond at a time so long waits can't overflow the cycle counter
+	const auto cyclesPerMillisecond{rcc_ahb_frequency / 1000U};
+	for (uint32_t elapsed{0U}; elapsed < milliseconds; ++elapsed)
+	{
+		const auto start{dwt_read_cycle_counter()};
+		while (dwt_read_cycle_counter() - start < cyclesPerMillisecond)
+			continue;
+	}
+	const auto after{semihosting::busLoad::snapshot()};
+	const auto bytesPerSecond{semihosting::busLoad::report("busContention"sv, before)};
+
+	semihosting::busLoad::stop();
+	if (wasRunning)
+		static_cast<void>(semihosting::busLoad::start(previousConfig));
+	host.result("busContention"sv, "priority"sv, priority);
+	host.result("busContention"sv, "burst"sv, burst);
+	resident::postResult(bytesPerSecond);
+	resident::postResult(after.errors - before.errors);
+	if (after.errors != before.errors)
+	{
+		host.error("DMA transfer errors occurred while loading the bus"sv);
+		return false;
+	}
+	return true;
+}
+
+// Write a small file as open, write and close over and over - once as individual calls and once as a batch - to
+// show what collapsing the three halts into one saves. Without debugger support the batch runs as individual calls.
+// Both are timed on the wall clock, as the saving is almost all in time the core spends halted
+[[nodiscard]] static bool batchedIO(const uint32_t iterations) noexcept
+{
+	const auto data{substrate::span{alphabet}};
+	const substrate::span<const uint8_t> payload{reinterpret_cast<const uint8_t *>(data.data()), data.size()};
+	const auto supported{semihosting::batchSupported()};
+	host.result("batchedIO"sv, "batchSupported"sv, supported ? 1U : 0U);
+
+	bool result{true};
+	uint64_t individualCycles{0U};
+	Summary individualSummary{};
+	for ([[maybe_unused]] const auto iteration : substrate::indexSequence_t{iterations})
+	{
+		const auto start{semihosting::wallClock::now()};
+		const auto fd{semihosting::open(testBatchFile, OpenMode::writeBinary)};
+		result &= fd != -1 && semihosting::write(fd, payload) == 0 &&
+			semihosting::close(fd) == SemihostingResult::success;
+		const auto cycles{semihosting::wallClock::now() - start};
+		individualCycles += cycles;
+		individualSummary.add(cycles);
+	}
+
+	semihosting::Batch<3> batch{};
+	uint64_t batchedCycles{0U};
+	Summary batchedSummary{};
+	for ([[maybe_unused]] const auto iteration : substrate::indexSequence_t{iterations})
+	{
+		const auto start{semihosting::wallClock::now()};
+		batch.clear();
+		const auto open{batch.open(testBatchFile, OpenMode::writeBinary)};
+		const auto write{batch.write(open, payload)};
+		static_cast<void>(batch.close(open));
+		result &= batch.run() && batch.result(write) == 0;
+		const auto cycles{semihosting::wallClock::now() - start};
+		batchedCycles += cycles;
+		batchedSummary.add(cycles);
+	}
+
+	// Read the file back in one more batch to check what the batches wrote
+	std::array<uint8_t, alphabet.size()> readBack{};
+	batch.clear();
+	const auto open{batch.open(testBatchFile, OpenMode::readBinary)};
+	const auto read{batch.read(open, readBack)};
+	static_cast<void>(batch.close(open));
+	if (!batch.run() || batch.result(read) != 0 ||
+		std::string_view{reinterpret_cast<const char *>(readBack.data()), readBack.size()} != alphabet)
+	{
+		host.error("Batched read back failed: errno = "sv, batch.error(open));
+		result = false;
+	}
+	if (semihosting::remove(testBatchFile) != SemihostingResult::success)
+		result = false;
+
+	host.result("batchedIO"sv, "individualCycles"sv, iterations, individualCycles);
+	host.result("batchedIO"sv, "batchedCycles"sv, iterations, batchedCycles);
+	individualSummary.report("batchedIO"sv, "individual"sv);
+	batchedSummary.report("batchedIO"sv, "batched"sv);
+	resident::postResult(static_cast<uint32_t>(individualCycles));
+	resident::postResult(static_cast<uint32_t>(batchedCycles));
+	if (!result)
+		host.error("Batched IO benchmark failed"sv);
+	return result;
+}
+
+static Task testIsError() noexcept
 {
 	host.warn("-> "sv, __func__);
 	host.info("Testing SYS_ISERROR on the first 100 possible error codes"sv);
 	// Loop through the first 100 possible error codes from SYS_ERRNO
 	for (const auto code : substrate::indexSequence_t{100U})
 	{
-		// Look the code up in the map
-		const auto codeMapping{fileIOErrno.find(static_cast<FileIOErrno>(code))};
-		const auto inMap{codeMapping != fileIOErrno.end()};
+		// Look the code up in the name table - every named code other than success is an error
+		const auto errorCode{static_cast<FileIOErrno>(code)};
+		const auto expectError{errorCode != FileIOErrno::success && !enumName(errorCode).empty()};
 		// Make the semihosting request (our syscalls layer turns it into a bool for us)
 		const auto isError{semihosting::isError(static_cast<int32_t>(code))};
 		// Check that the error state matches what's expected
-		if (isError != inMap)
+		if (isError != expectError)
 		{
 			host.error("SYS_ISERROR failed - host considers "sv, code, " to"sv, isError ? ""sv : " not"sv,
-				" be an error when it should"sv, inMap ? ""sv : " not"sv);
-			return false;
+				" be an error when it should"sv, expectError ? ""sv : " not"sv);
+			co_return false;
 		}
-		// If it matches and it is an error (in the map), display the description in the success notice
-		if (inMap)
-			host.notice("SYS_ISERROR success for "sv, codeMapping->second);
-		// Otherwise display that it was the success "error" code, which is not considered an error
-		else if (code == 0)
-			host.notice("SYS_ISERROR success for "sv, "FILEIO_SUCCESS (no error)"sv);
+		// If it matches and it has a name, display it and its description in the success notice
+		if (!enumName(errorCode).empty())
+			host.notice("SYS_ISERROR success for "sv, errorCode, " ("sv, enumDescription(errorCode), ")"sv);
+		// Each code is independent, so let anything overlapped with us have a turn between them
+		co_await Yield{};
 	}
 	host.notice("SYS_ISERROR success"sv);
-	return true;
+	co_return true;
 }
 
 [[nodiscard]] static bool testHeapInfo() noexcept
@@ -431,6 +1084,10 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	host.notice("SYS_HEAPINFO success"sv);
 	host.notice("Heap base: "sv, infoBlock.heapBase, ", limit: "sv, infoBlock.heapLimit);
 	host.notice("Stack base: "sv, infoBlock.stackBase, ", limit: "sv, infoBlock.stackLimit);
+	// Now use what the host told us to (re)seat the arena, so it reflects the host's view of the heap
+	const auto fromHost{semihosting::memory::setupArena(infoBlock)};
+	host.info("Arena spans "sv, arena.regionBase(), " to "sv, arena.regionLimit(), " ("sv, arena.size(),
+		" bytes) from "sv, fromHost ? "the host heap"sv : "linker-defined free RAM"sv);
 	return true;
 }
 
@@ -518,7 +1175,7 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	return true;
 }
 
-[[nodiscard]] static bool testTimekeeping() noexcept
+static Task testTimekeeping() noexcept
 {
 	host.warn("-> "sv, __func__);
 	// Check that we can retrieve the current time in seconds and that it goes up at aproximately the right rate
@@ -557,37 +1214,42 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	if (startTime == UINT32_MAX)
 	{
 		host.error("Failed to configure the internal timer for this test"sv);
-		return false;
+		co_return false;
 	}
 	const auto period{(timer_get_period(TIM1) + 1U) >> 1U};
+	// Summarise how long each request takes (on the wall clock, so the host's side counts) rather than logging every one
+	Summary timeCycles{};
 	// Run 5 requests for the time in succession, checking that they land the right distance apart
 	// and are differing values, indicating that the host is counting up properly in seconds
 	for (const auto iteration : substrate::indexSequence_t{5U})
 	{
-		// Wait for the counter to expire and request the time again
-		while (!timer_get_flag(TIM1, TIM_SR_UIF))
-			continue;
-		timer_clear_flag(TIM1, TIM_SR_UIF);
+		// Wait for the counter to expire (running anything overlapped with us meanwhile) and request the time again
+		const auto late{co_await TimerUpdate{TIM1, hostReadGuard}};
+		const auto callStart{semihosting::wallClock::now()};
 		const auto currentTime{semihosting::time()};
+		timeCycles.add(semihosting::wallClock::now() - callStart);
 		const auto expectedTimestep{period * (iteration + 1U)};
 		const auto actualTimestep{(currentTime - startTime) * 1000U};
-		host.info("Timestep "sv, iteration + 1U, ": "sv, currentTime);
+		// If we were resumed late the host may have ticked over into the next second (or more) by the time
+		// it was asked, so allow for however many seconds the lateness (in ms) could have spanned
+		const auto lateAllowance{(((late >> 1U) + 999U) / 1000U) * 1000U};
 		// Check that the resulting time gap tallies with the timer
-		if (expectedTimestep != actualTimestep)
+		if (actualTimestep < expectedTimestep || actualTimestep > expectedTimestep + lateAllowance)
 		{
 			timer_disable_counter(TIM1);
 			host.error("Timestep of "sv, actualTimestep, " too "sv,
 				actualTimestep < expectedTimestep ? "short"sv : "long"sv, ", expected "sv, expectedTimestep);
-			return false;
+			co_return false;
 		}
 	}
 	// Finish up by disabling the counter again
 	timer_disable_counter(TIM1);
+	timeCycles.report("timekeeping"sv, "timeCycles"sv);
 	host.notice("SYS_TIME success"sv);
-	return true;
+	co_return true;
 }
 
-[[nodiscard]] static bool testIntervals() noexcept
+static Task testIntervals() noexcept
 {
 	host.warn("-> "sv, __func__);
 	// Check that we can retrieve the time elapsed since the start of execution in centiseconds
@@ -604,38 +1266,45 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	{
 		timer_disable_counter(TIM1);
 		host.error("SYS_CLOCK failed"sv);
-		return false;
+		co_return false;
 	}
 	host.info("Starting time: "sv, wallTime);
 	auto period{(timer_get_period(TIM1) + 1U) >> 1U};
+	// How late (in ms) after the timer's update the last request was made
+	uint32_t lastLate{0U};
+	// Summarise how long each request takes (on the wall clock, so the host's side counts) rather than logging every one
+	Summary clockCycles{};
 	// Run 5 requests for the wall clock in succession, checking that they land the right distance
 	// apart and are differing values, indicating that the host is counting up properly in centiseconds
-	for (const auto iteration : substrate::indexSequence_t{5U})
+	for ([[maybe_unused]] const auto iteration : substrate::indexSequence_t{5U})
 	{
-		// Wait for the counter to expire and request the wall clock again
-		while (!timer_get_flag(TIM1, TIM_SR_UIF))
-			continue;
-		timer_clear_flag(TIM1, TIM_SR_UIF);
+		// Wait for the counter to expire (running anything overlapped with us meanwhile) and request the wall clock again
+		const auto late{(co_await TimerUpdate{TIM1, hostReadGuard}) >> 1U};
+		const auto callStart{semihosting::wallClock::now()};
 		const auto currentTime{semihosting::clock()};
+		clockCycles.add(semihosting::wallClock::now() - callStart);
 		const auto timestep{(currentTime - wallTime) * 10U};
-		host.info("Timestep "sv, iteration + 1U, ": "sv, currentTime);
+		// Correct for any difference in how late this request and the last were made after their updates
+		const auto expected{period + late - lastLate};
 		// Check that the resulting time gap tallies with the timer (±40ms)
-		if (timestep < period - 40U || timestep > period + 40U)
+		if (timestep < expected - 40U || timestep > expected + 40U)
 		{
 			timer_disable_counter(TIM1);
 			host.error("Timestep of "sv, timestep, " too "sv,
-				timestep < period ? "short"sv : "long"sv, ", expected "sv, period);
-			return false;
+				timestep < expected ? "short"sv : "long"sv, ", expected "sv, expected);
+			co_return false;
 		}
 		wallTime = currentTime;
+		lastLate = late;
 		// Increase the timestep interval by 150ms
 		period += 150U;
 		timer_set_period(TIM1, (period << 1U) - 1U);
 	}
 	// Finish up by disabling the counter again
 	timer_disable_counter(TIM1);
+	clockCycles.report("intervals"sv, "clockCycles"sv);
 	host.notice("SYS_CLOCK success"sv);
-	return true;
+	co_return true;
 }
 
 [[nodiscard]] static bool testExits() noexcept
@@ -653,26 +1322,416 @@ template<size_t N> [[nodiscard]] static size_t strlen(const std::array<char, N>
 	return true;
 }
 
+// Run a coroutine test on its own, for when it is not being overlapped with anything else
+template<Task (*task)() noexcept> [[nodiscard]] static bool runToCompletion() noexcept
+{
+	const ArenaScope scope{arena};
+	return semihosting::scheduler::runToCompletion(task());
+}
+
+// How a test may be scheduled when the whole suite is run
+enum class Schedule : uint8_t
+{
+	// Runs on its own, in order
+	sequential,
+	// Spends most of its time waiting on a timer, and may have background tests run in those gaps
+	overlapTimed,
+	// Independent of the tests around it, and may be run in the gaps left by timed tests
+	overlapBackground,
+};
+
+struct test_t final
+{
+	std::string_view name;
+	bool (*function)() noexcept;
+	// If the test is a coroutine, the function that creates it (function then wraps this for running alone)
+	Task (*task)() noexcept{nullptr};
+	Schedule schedule{Schedule::sequential};
+};
+
+using benchmarkParameters_t = std::array<uint32_t, 3>;
+
+struct benchmark_t final
+{
+	std::string_view name;
+	bool (*function)(const benchmarkParameters_t &parameters) noexcept;
+};
+
+// The suite, in the order it must be run in as later tests rely on state left by earlier ones. Each run of
+// adjacent overlappable tests is run as two chains side by side - the timed tests in order in one, and the
+// background tests in order in the other. heapInfo reseats the arena the scheduler allocates from, so must
+// never be overlapped, and errno must not yield between its two syscalls so nothing can disturb the host's errno
+constexpr static std::array<test_t, 14> tests
+{{
+	{"readCommandLine"sv, testReadCommandLine},
+	{"consoleHandles"sv, testConsoleHandles},
+	{"semihostingFeatures"sv, testSemihostingFeatures},
+	{"consoleWrite"sv, testConsoleWrite},
+	{"fileIO"sv, testFileIO},
+	{"fileHandleScaling"sv, testFileHandleScaling},
+	{"heapInfo"sv, testHeapInfo},
+	{"isError"sv, runToCompletion<testIsError>, testIsError, Schedule::overlapBackground},
+	{"errno"sv, testErrno, nullptr, Schedule::overlapBackground},
+	{"timing"sv, testTiming, nullptr, Schedule::overlapBackground},
+	{"tempName"sv, testTempName, nullptr, Schedule::overlapBackground},
+	{"timekeeping"sv, runToCompletion<testTimekeeping>, testTimekeeping, Schedule::overlapTimed},
+	{"intervals"sv, runToCompletion<testIntervals>, testIntervals, Schedule::overlapTimed},
+	{"exits"sv, testExits},
+}};
+
+constexpr static std::array<benchmark_t, 6> benchmarks
+{{
+	// parameters[0] is the maximum number of files to hold open, or 0 for the default
+	{
+		"fileHandleScaling"sv,
+		[](const benchmarkParameters_t &parameters) noexcept
+		{
+			const auto maxFDs{parameters[0] ? std::min<size_t>(parameters[0], maxConcurrentFDs) : maxConcurrentFDs};
+			return fileHandleScaling(maxFDs);
+		}
+	},
+	// parameters[0] is the maximum buffer size to use (0 for all free RAM), parameters[1] the number of passes
+	{
+		"fileThroughput"sv,
+		[](const benchmarkParameters_t &parameters) noexcept
+			{ return fileThroughput(parameters[0], parameters[1] ? parameters[1] : defaultThroughputPasses); }
+	},
+	// parameters[0] is the number of workload iterations to run, or 0 for the default
+	{
+		"flashVsRAM"sv,
+		[](const benchmarkParameters_t &parameters) noexcept
+			{ return flashVsRAM(parameters[0] ? parameters[0] : defaultWorkloadIterations); }
+	},
+	// parameters[0] is the size of file to work through in bytes (0 for the default), parameters[1] the
+	// most pages to keep resident at once (0 for the whole window)
+	{
+		"mappedFile"sv,
+		[](const benchmarkParameters_t &parameters) noexcept
+			{ return mappedFileScan(parameters[0] ? parameters[0] : defaultMappedFileSize, parameters[1]); }
+	},
+	// parameters[0] is how long to load the bus for in milliseconds (0 for the default), parameters[1] the
+	// DMA priority from 0 (low) to 3 (very high), and parameters[2] the burst size (0 for the default)
+	{
+		"busContention"sv,
+		[](const benchmarkParameters_t &parameters) noexcept
+		{
+			return busContention(parameters[0] ? parameters[0] : defaultBusContentionTime, parameters[1],
+				parameters[2] ? static_cast<uint8_t>(parameters[2]) : defaultBusContentionBurst);
+		}
+	},
+	// parameters[0] is the number of times to write the file each way, or 0 for the default
+	{
+		"batchedIO"sv,
+		[](const benchmarkParameters_t &parameters) noexcept
+			{ return batchedIO(parameters[0] ? parameters[0] : defaultBatchIterations); }
+	},
+}};
+
+// Report the peak stack usage seen by a test (or group of tests), complaining if it used the whole reservation
+static void reportStackUsage(const std::string_view name, const size_t stackUsed) noexcept
+{
+	host.result("stackUsage"sv, name, stackUsed);
+	if (stackUsed >= semihosting::stack::reserve())
+		host.error("Test "sv, name, " overflowed the "sv, semihosting::stack::reserve(), " byte stack reservation"sv);
+}
+
+// Run a single test from the suite, reporting the peak stack usage seen while it ran
+[[nodiscard]] static bool runTest(const test_t &test) noexcept
+{
+	semihosting::stack::paint();
+	const auto irqLoadBefore{semihosting::irqLoad::snapshot()};
+	const auto busLoadBefore{semihosting::busLoad::snapshot()};
+	bool result{false};
+	{
+		const semihosting::perf::PerfScope scope{test.name};
+		result = test.function();
+	}
+	semihosting::irqLoad::report(test.name, irqLoadBefore);
+	static_cast<void>(semihosting::busLoad::report(test.name, busLoadBefore));
+	// Write out anything interrupt handlers logged while the test ran, now that it is safe to
+	logQueue.flush();
+	reportStackUsage(test.name, semihosting::stack::highWaterMark());
+	return result;
+}
+
+// The peak stack usage of the overlapped group so far, kept across the repaints of its plain function tests
+static size_t overlappedStackUsed{0U};
+
+// Run the tests from a group that have the given schedule, one after the other
+static Task runChain(const substrate::span<const test_t> group, const Schedule schedule) noexcept
+{
+	for (const auto &test : group)
+	{
+		if (test.schedule != schedule)
+			continue;
+		if (test.task)
+		{
+			// A coroutine test's figures take in whatever the other chain ran while it was suspended, just as
+			// running it alone takes in the time spent waiting. Its stack can't be told apart from the other
+			// chain's, so only counts towards the group's figure
+			const semihosting::perf::PerfScope scope{test.name};
+			if (!co_await test.task())
+				co_return false;
+		}
+		else
+		{
+			// Nothing else runs during a plain function, so it can be measured on its own as it would be alone -
+			// folding the group's use so far into the group's figure before the repaint loses it
+			overlappedStackUsed = std::max(overlappedStackUsed, semihosting::stack::highWaterMark());
+			semihosting::stack::paint();
+			bool result{false};
+			{
+				const semihosting::perf::PerfScope scope{test.name};
+				result = test.function();
+			}
+			const auto stackUsed{semihosting::stack::highWaterMark()};
+			overlappedStackUsed = std::max(overlappedStackUsed, stackUsed);
+			reportStackUsage(test.name, stackUsed);
+			if (!result)
+				co_return false;
+			co_await Yield{};
+		}
+	}
+	co_return true;
+}
+
+// Run a group of overlappable tests, with the background ones filling the gaps left by the timed ones. The
+// tests interleave, so stack usage and counters are reported for the group as a whole
+[[nodiscard]] static bool runOverlapped(const substrate::span<const test_t> group) noexcept
+{
+	const ArenaScope scope{arena};
+	semihosting::stack::paint();
+	overlappedStackUsed = 0U;
+	const auto irqLoadBefore{semihosting::irqLoad::snapshot()};
+	const auto busLoadBefore{semihosting::busLoad::snapshot()};
+	bool result{false};
+	{
+		// Each test is profiled on its own as well, inside this
+		const semihosting::perf::PerfScope perfScope{"overlapped"sv};
+		std::array<Task, 2> chains
+		{{
+			runChain(group, Schedule::overlapTimed),
+			runChain(group, Schedule::overlapBackground),
+		}};
+		result = semihosting::scheduler::runConcurrently(chains);
+	}
+	semihosting::irqLoad::report("overlapped"sv, irqLoadBefore);
+	static_cast<void>(semihosting::busLoad::report("overlapped"sv, busLoadBefore));
+	logQueue.flush();
+	reportStackUsage("overlapped"sv, std::max(overlappedStackUsed, semihosting::stack::highWaterMark()));
+	return result;
+}
+
+// Run a single benchmark, reporting how any interrupt or bus load fared while it ran
+[[nodiscard]] static bool runBenchmark(const benchmark_t &benchmark, const benchmarkParameters_t &parameters) noexcept
+{
+	const auto irqLoadBefore{semihosting::irqLoad::snapshot()};
+	const auto busLoadBefore{semihosting::busLoad::snapshot()};
+	const auto result{benchmark.function(parameters)};
+	semihosting::irqLoad::report(benchmark.name, irqLoadBefore);
+	static_cast<void>(semihosting::busLoad::report(benchmark.name, busLoadBefore));
+	return result;
+}
+
 [[nodiscard]] static bool testSemihosting() noexcept
 {
-	return
-		testReadCommandLine() &&
-		testConsoleHandles() &&
-		testSemihostingFeatures() &&
-		testConsoleWrite() &&
-		testFileIO() &&
-		testIsError() &&
-		testHeapInfo() &&
-		testErrno() &&
-		testTiming() &&
-		testTempName() &&
-		testTimekeeping() &&
-		testIntervals() &&
-		testExits();
+	for (size_t index{0U}; index < tests.size();)
+	{
+		if (tests[index].schedule == Schedule::sequential)
+		{
+			if (!runTest(tests[index++]))
+				return false;
+			continue;
+		}
+		// Gather up the run of overlappable tests starting here and run them together
+		const auto begin{index};
+		while (index < tests.size() && tests[index].schedule != Schedule::sequential)
+			++index;
+		if (!runOverlapped({tests.data() + begin, index - begin}))
+			return false;
+	}
+	return true;
+}
+
+#ifdef RESIDENT_MODE
+// Run a single command posted to the mailbox by the host
+[[nodiscard]] static resident::Status runCommand(const resident::Command command) noexcept
+{
+	using resident::Command;
+	using resident::Status;
+	const auto toStatus{[](const bool result) noexcept { return result ? Status::passed : Status::failed; }};
+
+	switch (command)
+	{
+		case Command::runTest:
+		{
+			const auto index{mailbox.parameters[0]};
+			if (index >= tests.size())
+				return Status::invalidCommand;
+			host.notice("Running test "sv, tests[index].name);
+			return toStatus(runTest(tests[index]));
+		}
+		case Command::runSuite:
+			return toStatus(testSemihosting());
+		case Command::runBenchmark:
+		{
+			const auto index{mailbox.parameters[0]};
+			if (index >= benchmarks.size())
+				return Status::invalidCommand;
+			const benchmarkParameters_t parameters{{mailbox.parameters[1], mailbox.parameters[2], mailbox.parameters[3]}};
+			host.notice("Running benchmark "sv, benchmarks[index].name);
+			return toStatus(runBenchmark(benchmarks[index], parameters));
+		}
+		case Command::describe:
+			resident::postResult(tests.size());
+			resident::postResult(benchmarks.size());
+			return Status::passed;
+#ifdef SEMIHOSTING_TRACE
+		case Command::dumpTrace:
+			return toStatus(semihosting::trace::dump());
+#endif
+		default:
+			return Status::invalidCommand;
+	}
 }
 
+// Serve commands from the mailbox until the host asks us to exit
+static void runResident() noexcept
+{
+	resident::initMailbox();
+	host.notice("Resident mode ready, mailbox at "sv, reinterpret_cast<uintptr_t>(&mailbox));
+	while (true)
+	{
+		if (!resident::commandPending())
+			continue;
+		const auto command{static_cast<resident::Command>(mailbox.command)};
+		resident::beginCommand();
+		if (command == resident::Command::exit)
+		{
+			resident::completeCommand(resident::Status::passed, 0U);
+			return;
+		}
+		// Time the command on the wall clock, as most of a semihosting-heavy command is spent halted
+		const auto start{semihosting::wallClock::now()};
+		const auto status{runCommand(command)};
+		resident::completeCommand(status, semihosting::wallClock::now() - start);
+	}
+}
+#elif defined(INTERACTIVE_MODE)
+// Serve commands read from the host console (typed, or piped in by a script) until told to exit
+static void runInteractive() noexcept
+{
+	InputReader input{host.stdinFD()};
+	std::array<char, 32U> token{};
+	host.notice("Interactive mode ready - commands: list, test <index>, suite, bench <index> [parameters...], exit"sv);
+	while (true)
+	{
+		const auto command{input.readToken(token)};
+		if (!command || *command == "exit"sv)
+			return;
+		if (*command == "list"sv)
+		{
+			for (size_t index{0U}; index < tests.size(); ++index)
+				host.info("test "sv, index, ": "sv, tests[index].name);
+			for (size_t index{0U}; index < benchmarks.size(); ++index)
+				host.info("bench "sv, index, ": "sv, benchmarks[index].name);
+		}
+		else if (*command == "test"sv)
+		{
+			const auto index{input.endOfLine() ? std::optional<uint32_t>{} : input.readNumber<uint32_t>()};
+			if (!index || *index >= tests.size())
+				host.error("Invalid test index"sv);
+			else if (runTest(tests[*index]))
+				host.notice("Test "sv, tests[*index].name, " passed"sv);
+			else
+				host.error("Test "sv, tests[*index].name, " failed"sv);
+		}
+		else if (*command == "suite"sv)
+		{
+			if (testSemihosting())
+				host.notice("Test complete (success)"sv);
+			else
+				host.error("Test failed"sv);
+		}
+		else if (*command == "bench"sv)
+		{
+			const auto index{input.endOfLine() ? std::optional<uint32_t>{} : input.readNumber<uint32_t>()};
+			// Any parameters not given on the line are left as 0 so the benchmark uses its defaults
+			benchmarkParameters_t parameters{};
+			bool parametersValid{true};
+			for (auto &parameter : parameters)
+			{
+				if (input.endOfLine())
+					break;
+				const auto value{input.readNumber<uint32_t>()};
+				parametersValid &= value.has_value();
+				parameter = value.value_or(0U);
+			}
+			if (!index || *index >= benchmarks.size() || !parametersValid)
+				host.error("Invalid benchmark index or parameters"sv);
+			else if (!runBenchmark(benchmarks[*index], parameters))
+				host.error("Benchmark "sv, benchmarks[*index].name, " failed"sv);
+		}
+#ifdef SEMIHOSTING_TRACE
+		else if (*command == "trace"sv)
+		{
+			if (semihosting::trace::dump())
+				host.notice("Trace written to "sv, semihosting::trace::traceFile);
+			else
+				host.error("Failed to write the trace out"sv);
+		}
+#endif
+		else
+			host.error("Unknown command "sv, *command);
+		// Throw away anything else left on the line so a bad command can't desynchronise us
+		input.skipLine();
+	}
+}
+#elif defined(SOAK_MODE)
+static_assert(tests.size() <= soak::maxTests);
+
+static void soakReport() noexcept
+{
+	soak::reportTotals();
+	for (size_t index{0U}; index < tests.size(); ++index)
+		soak::report(index, tests[index].name);
+	semihosting::perf::report();
+}
+
+// Run the suite over and over, keeping per-test results in .noinit RAM so they survive the watchdog
+// pulling us out of a hang. Each test is run on its own so its latency and any hang can be charged to it
+[[noreturn]] static void runSoak() noexcept
+{
+	if (soak::initState(tests.size()))
+	{
+		host.notice("Resuming soak run at iteration "sv, soak::state.iterations, ", boot "sv, soak::state.boots);
+		soakReport();
+	}
+	else
+		host.notice("Starting soak run"sv);
+	soak::startWatchdog();
+	while (true)
+	{
+		for (size_t index{0U}; index < tests.size(); ++index)
+		{
+			soak::beginTest(index);
+			// Time the test on the wall clock so the host's share of it counts - tests can outlast a 32-bit wrap
+			const auto start{semihosting::wallClock::now64()};
+			const auto result{runTest(tests[index])};
+			const auto elapsed{semihosting::wallClock::now64() - start};
+			soak::endTest(index, result, semihosting::wallClock::microseconds(elapsed));
+		}
+		soak::endIteration();
+		if (soak::state.iterations % soakReportInterval == 0U)
+			soakReport();
+	}
+}
+#endif
+
 int main(int, char **)
 {
+	// Paint the stack first thing so we can track how much of it gets used
+	semihosting::stack::paint();
 	// Set up clocking for later when we want to run the timekeeping tests
 	rcc_clock_setup_pll(&rcc_hsi_configs[RCC_CLOCK_3V3_84MHZ]);
 	rcc_periph_clock_enable(RCC_TIM1);
@@ -693,14 +1752,56 @@ int main(int, char **)
 	// Set that we only care about updates on counter overflow
 	timer_update_on_overflow(TIM1);
 
+	// Turn on the DWT cycle counter so tests can take cycle-accurate latency measurements, along with the
+	// event counters so we can profile where those cycles go
+	dwt_enable_cycle_counter();
+	semihosting::perf::enableCounters();
+	// And the wall clock, for measurements that have to include the time the host spends on a call
+	semihosting::wallClock::start();
+#ifdef INTERRUPT_LOAD_MODE
+	// Put the background interrupt load on before the first semihosting call so everything runs under it
+	semihosting::irqLoad::start(INTERRUPT_LOAD_RATE);
+#endif
+#ifdef BUS_LOAD_MODE
+	// Likewise the DMA bus load, so the suite's own memory traffic and any probe accesses made while the core
+	// runs have to contend with it. It relies on its interrupts to keep going, so it idles while the core is
+	// halted and the probe's accesses servicing semihosting calls go uncontended
+	static_cast<void>(semihosting::busLoad::start(
+		{static_cast<semihosting::busLoad::Priority>(BUS_LOAD_PRIORITY), BUS_LOAD_BURST}));
+#endif
+
 	// Try to open the host's console interface, and if that fails, return as there's nothing more can be done
 	if (!host.openConsole())
 		return 1;
+#ifdef BUS_LOAD_MODE
+	// Make sure the run's results say what the load does and doesn't cover
+	host.notice("Bus load only contends accesses made while the core runs, not those made while it is halted"sv);
+#endif
+
+	// Find out where the host thinks the heap is and set the arena allocator up over it
+	HeapInfoBlock infoBlock{};
+	semihosting::heapInfo(infoBlock);
+	static_cast<void>(semihosting::memory::setupArena(infoBlock));
+#ifdef RESIDENT_MODE
+	runResident();
+#elif defined(INTERACTIVE_MODE)
+	runInteractive();
+#elif defined(SOAK_MODE)
+	runSoak();
+#else
 	host.notice("Testing semihosting support"sv);
 	if (testSemihosting())
 		host.notice("Test complete (success)"sv);
 	else
 		host.error("Test failed"sv);
+#ifdef SEMIHOSTING_TRACE
+	// Leave a record of the calls that led up to here, pass or fail, for the replay tool
+	if (!semihosting::trace::dump())
+		host.error("Failed to write the trace out"sv);
+#endif
+#endif
+	logQueue.flush();
+	semihosting::perf::report();
 
 	// Try to close the host's console interface, and if that fails return so the test restarts
 	if (!host.closeConsole())
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/iwdg.h>
+#include "soak.hxx"
+#include "hostConsole.hxx"
+
+using namespace std::literals::string_view_literals;
+
+namespace semihosting::soak
+{
+	using host::console::host;
+
+	// The timekeeping test alone waits over 10s between feeds, so allow plenty of headroom (the IWDG tops
+	// out near 32s). Tests whose length grows with the host's speed feed the watchdog as they go
+	constexpr static uint32_t watchdogPeriod{30000U};
+
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+	[[gnu::section(".noinit"), gnu::used]] SoakState state;
+
+	static void clearState(const size_t testCount) noexcept
+	{
+		state.testCount = testCount;
+		state.iterations = 0U;
+		state.boots = 0U;
+		state.watchdogResets = 0U;
+		state.currentTest = noTest;
+		for (auto &test : state.tests)
+			test = {0U, 0U, 0U, 0U, UINT32_MAX, 0U, 0U};
+		state.version = soakVersion;
+		state.magic = soakMagic;
+	}
+
+	bool initState(const size_t testCount) noexcept
+	{
+		const auto resetCause{RCC_CSR};
+		// Clear the reset flags so the next reset's cause can be told apart from this one
+		RCC_CSR = RCC_CSR | RCC_CSR_RMVF;
+
+		const auto resumed
+		{
+			state.magic == soakMagic && state.version == soakVersion && state.testCount == testCount &&
+			(state.currentTest == noTest || state.currentTest < testCount)
+		};
+		if (!resumed)
+			clearState(testCount);
+
+		++state.boots;
+		const auto watchdogReset{(resetCause & RCC_CSR_IWDGRSTF) != 0U};
+		if (watchdogReset)
+			++state.watchdogResets;
+		// If we came back up part way through a test, that test hung (watchdog) or was cut short
+		if (state.currentTest != noTest)
+		{
+			auto &test{state.tests[state.currentTest]};
+			if (watchdogReset)
+				++test.hangs;
+			else
+				++test.interruptions;
+			state.currentTest = noTest;
+		}
+		return resumed;
+	}
+
+	void startWatchdog() noexcept
+	{
+		iwdg_set_period_ms(watchdogPeriod);
+		iwdg_start();
+	}
+
+	void feedWatchdog() noexcept
+		{ iwdg_reset(); }
+
+	void beginTest(const size_t index) noexcept
+	{
+		feedWatchdog();
+		state.currentTest = index;
+	}
+
+	void endTest(const size_t index, const bool result, const uint64_t elapsedMicroseconds) noexcept
+	{
+		// Over an hour is clearly a test gone wrong, so just pin it at the limit
+		const auto elapsed{static_cast<uint32_t>(std::min<uint64_t>(elapsedMicroseconds, UINT32_MAX))};
+		auto &test{state.tests[index]};
+		if (result)
+			++test.passes;
+		else
+			++test.failures;
+		if (elapsed < test.minMicroseconds)
+			test.minMicroseconds = elapsed;
+		if (elapsed > test.maxMicroseconds)
+			test.maxMicroseconds = elapsed;
+		test.totalMicroseconds += elapsed;
+		state.currentTest = noTest;
+		feedWatchdog();
+	}
+
+	void endIteration() noexcept
+		{ ++state.iterations; }
+
+	void report(const size_t index, const std::string_view name) noexcept
+	{
+		const auto &test{state.tests[index]};
+		const auto runs{uint64_t{test.passes} + test.failures};
+		host.result("soak"sv, name, "passes"sv, test.passes);
+		host.result("soak"sv, name, "failures"sv, test.failures);
+		host.result("soak"sv, name, "hangs"sv, test.hangs);
+		host.result("soak"sv, name, "interruptions"sv, test.interruptions);
+		if (!runs)
+			return;
+		host.result("soak"sv, name, "minMicroseconds"sv, test.minMicroseconds);
+		host.result("soak"sv, name, "meanMicroseconds"sv, test.totalMicroseconds / runs);
+		host.result("soak"sv, name, "maxMicroseconds"sv, test.maxMicroseconds);
+	}
+
+	void reportTotals() noexcept
+	{
+		host.result("soak"sv, "iterations"sv, state.iterations);
+		host.result("soak"sv, "boots"sv, state.boots);
+		host.result("soak"sv, "watchdogResets"sv, state.watchdogResets);
+	}
+} // namespace semihosting::soak
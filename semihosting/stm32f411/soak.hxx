@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOAK_HXX
+#define SOAK_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+
+namespace semihosting::soak
+{
+	constexpr static uint32_t soakMagic{0x4b414f53U}; // 'SOAK'
+	constexpr static uint32_t soakVersion{2U};
+	constexpr static size_t maxTests{16U};
+	constexpr static uint32_t noTest{UINT32_MAX};
+
+	struct TestRecord final
+	{
+		uint32_t passes;
+		uint32_t failures;
+		// Number of times the watchdog fired while this test was running
+		uint32_t hangs;
+		// Number of times some other reset (power, pin, brown-out) cut this test short
+		uint32_t interruptions;
+		// How long each run took on the wall clock, halts included, in microseconds
+		uint32_t minMicroseconds;
+		uint32_t maxMicroseconds;
+		uint64_t totalMicroseconds;
+	};
+
+	/*
+	 * The soak record lives in .noinit (see f4discovery.ld) so startup leaves it alone and it survives
+	 * watchdog and debugger resets. It is considered valid only while magic and version match, and is
+	 * cleared otherwise (such as on first power-up). currentTest notes which test was running so that a
+	 * reset can be charged to it on the next boot.
+	 */
+	struct SoakState final
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t testCount;
+		// Completed runs of the whole suite
+		uint32_t iterations;
+		uint32_t boots;
+		uint32_t watchdogResets;
+		uint32_t currentTest;
+		std::array<TestRecord, maxTests> tests;
+	};
+	// Must fit in the noinit region
+	static_assert(sizeof(SoakState) <= 1024U);
+
+	extern SoakState state;
+
+	// Validate the soak record, clearing it if it is not for a suite of testCount tests, then charge any reset
+	// that interrupted a test to that test. Returns true if an existing soak run is being resumed
+	[[nodiscard]] bool initState(size_t testCount) noexcept;
+	// Start the independent watchdog. The IWDG keeps counting while the core is halted, so tests that make
+	// long runs of semihosting calls must feed it as they go - this is harmless when it is not running
+	void startWatchdog() noexcept;
+	void feedWatchdog() noexcept;
+	void beginTest(size_t index) noexcept;
+	void endTest(size_t index, bool result, uint64_t elapsedMicroseconds) noexcept;
+	void endIteration() noexcept;
+	// Emit the totals and latency figures for a test as `[#] soak <test> <metric> <value>` lines
+	void report(size_t index, std::string_view name) noexcept;
+	// Emit the suite-wide counters
+	void reportTotals() noexcept;
+} // namespace semihosting::soak
+
+#endif /*SOAK_HXX*/
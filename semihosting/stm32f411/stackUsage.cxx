@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include "stackUsage.hxx"
+
+// These are provided by the linker script
+/* NOLINTBEGIN(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+extern "C" const uint8_t _stack;
+extern "C" const uint8_t stackReserve;
+/* NOLINTEND(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+
+namespace semihosting::stack
+{
+	constexpr static uint32_t paintPattern{0xa5c3a5c3U};
+
+	[[nodiscard]] static uintptr_t stackTop() noexcept
+		{ return reinterpret_cast<uintptr_t>(&_stack); }
+
+	[[nodiscard]] static uintptr_t stackBottom() noexcept
+		{ return stackTop() - reinterpret_cast<uintptr_t>(&stackReserve); }
+
+	size_t reserve() noexcept
+		{ return reinterpret_cast<uintptr_t>(&stackReserve); }
+
+	[[gnu::noinline]] void paint() noexcept
+	{
+		uintptr_t stackPointer{};
+		__asm__ volatile("mov %0, sp" : "=r"(stackPointer));
+		// Everything below the stack pointer is free, so paint from the bottom of the reservation up to it
+		auto *word{reinterpret_cast<volatile uint32_t *>(stackBottom())};
+		const auto *const end{reinterpret_cast<volatile uint32_t *>(stackPointer & ~uintptr_t{3U})};
+		for (; word < end; ++word)
+			*word = paintPattern;
+	}
+
+	size_t highWaterMark() noexcept
+	{
+		const auto *word{reinterpret_cast<const volatile uint32_t *>(stackBottom())};
+		const auto *const end{reinterpret_cast<const volatile uint32_t *>(stackTop())};
+		// The first word that no longer holds the pattern marks the deepest point the stack reached
+		while (word < end && *word == paintPattern)
+			++word;
+		return stackTop() - reinterpret_cast<uintptr_t>(word);
+	}
+} // namespace semihosting::stack
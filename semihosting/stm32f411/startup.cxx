@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <array>
+#include <libopencm3/cm3/scb.h>
+
+// These are provided by the linker script
+/* NOLINTBEGIN(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+extern "C" const uint32_t _stack;
+extern "C" const uint32_t beginDataLoad;
+extern "C" uint32_t beginData;
+extern "C" const uint32_t endData;
+extern "C" uint32_t beginBSS;
+extern "C" const uint32_t endBSS;
+/* NOLINTEND(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
+
+using ctorFuncs_t = void (*)();
+extern "C" const ctorFuncs_t beginCtors, endCtors;
+
+// Calling main() directly is not allowed in C++, so reach it through an alias to its symbol instead
+extern "C" int runMain(int argc, char **argv) __asm__("main");
+
+using irqFunction_t = void (*)();
+
+/*
+ * The handlers use the libopencm3 names so the peripheral headers' declarations match them. Each is weak
+ * and defaults to irqUnhandled(), so any part of the firmware can take over a vector just by defining it.
+ */
+extern "C"
+{
+	void irqReset() noexcept;
+	void irqUnhandled() noexcept;
+	[[gnu::naked]] void irqHardFault() noexcept;
+
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void nmi_handler();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void mem_manage_handler();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void bus_fault_handler();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void usage_fault_handler();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void sv_call_handler();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void debug_monitor_handler();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void pend_sv_handler();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void sys_tick_handler();
+
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void wwdg_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void pvd_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tamp_stamp_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void rtc_wkup_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void flash_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void rcc_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void exti0_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void exti1_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void exti2_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void exti3_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void exti4_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream0_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream1_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream2_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream3_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream4_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream5_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream6_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void adc_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void exti9_5_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim1_brk_tim9_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim1_up_tim10_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim1_trg_com_tim11_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim1_cc_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim2_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim3_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim4_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void i2c1_ev_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void i2c1_er_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void i2c2_ev_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void i2c2_er_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void spi1_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void spi2_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void usart1_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void usart2_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void exti15_10_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void rtc_alarm_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void otg_fs_wkup_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma1_stream7_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void sdio_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void tim5_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void spi3_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream0_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream1_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream2_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream3_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream4_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void otg_fs_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream5_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream6_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void dma2_stream7_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void usart6_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void i2c3_ev_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void i2c3_er_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void fpu_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void spi4_isr();
+	[[gnu::weak, gnu::alias("irqUnhandled")]] void spi5_isr();
+}
+
+struct nvicTable_t final
+{
+	const void *stackTop;
+	std::array<irqFunction_t, 101> vectorTable;
+};
+
+[[gnu::section(".nvic_table"), gnu::used]] static const nvicTable_t nvicTable
+{
+	&_stack,
+	{
+		irqReset, /* Reset handler */
+		nmi_handler, /* NMI handler */
+		irqHardFault, /* Hard Fault handler */
+
+		/* Configurable priority handlers */
+		mem_manage_handler, /* Memory Management fault */
+		bus_fault_handler, /* Bus fault */
+		usage_fault_handler, /* Usage fault */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		sv_call_handler, /* SV Call */
+		debug_monitor_handler, /* Debug Monitor */
+		nullptr, /* Reserved */
+		pend_sv_handler, /* Pending SV */
+		sys_tick_handler, /* Sys Tick */
+
+		/* Peripheral handlers */
+		wwdg_isr, /* Window Watchdog */
+		pvd_isr, /* PVD through EXTI line 16 */
+		tamp_stamp_isr, /* Tamper and TimeStamp through EXTI line 21 */
+		rtc_wkup_isr, /* RTC Wakeup through EXTI line 22 */
+		flash_isr, /* Flash */
+		rcc_isr, /* RCC */
+		exti0_isr, /* EXTI line 0 */
+		exti1_isr, /* EXTI line 1 */
+		exti2_isr, /* EXTI line 2 */
+		exti3_isr, /* EXTI line 3 */
+		exti4_isr, /* EXTI line 4 */
+		dma1_stream0_isr, /* DMA1 Stream 0 */
+		dma1_stream1_isr, /* DMA1 Stream 1 */
+		dma1_stream2_isr, /* DMA1 Stream 2 */
+		dma1_stream3_isr, /* DMA1 Stream 3 */
+		dma1_stream4_isr, /* DMA1 Stream 4 */
+		dma1_stream5_isr, /* DMA1 Stream 5 */
+		dma1_stream6_isr, /* DMA1 Stream 6 */
+		adc_isr, /* ADC1 */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		exti9_5_isr, /* EXTI lines 9:5 */
+		tim1_brk_tim9_isr, /* TIM1 Break and TIM9 */
+		tim1_up_tim10_isr, /* TIM1 Update and TIM10 */
+		tim1_trg_com_tim11_isr, /* TIM1 Trigger, Commutation and TIM11 */
+		tim1_cc_isr, /* TIM1 Capture Compare */
+		tim2_isr, /* TIM2 */
+		tim3_isr, /* TIM3 */
+		tim4_isr, /* TIM4 */
+		i2c1_ev_isr, /* I2C1 Event */
+		i2c1_er_isr, /* I2C1 Error */
+		i2c2_ev_isr, /* I2C2 Event */
+		i2c2_er_isr, /* I2C2 Error */
+		spi1_isr, /* SPI1 */
+		spi2_isr, /* SPI2 */
+		usart1_isr, /* USART1 */
+		usart2_isr, /* USART2 */
+		nullptr, /* Reserved */
+		exti15_10_isr, /* EXTI lines 15:10 */
+		rtc_alarm_isr, /* RTC Alarms through EXTI line 17 */
+		otg_fs_wkup_isr, /* USB OTG FS Wakeup through EXTI line 18 */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		dma1_stream7_isr, /* DMA1 Stream 7 */
+		nullptr, /* Reserved */
+		sdio_isr, /* SDIO */
+		tim5_isr, /* TIM5 */
+		spi3_isr, /* SPI3 */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		dma2_stream0_isr, /* DMA2 Stream 0 */
+		dma2_stream1_isr, /* DMA2 Stream 1 */
+		dma2_stream2_isr, /* DMA2 Stream 2 */
+		dma2_stream3_isr, /* DMA2 Stream 3 */
+		dma2_stream4_isr, /* DMA2 Stream 4 */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		otg_fs_isr, /* USB OTG FS */
+		dma2_stream5_isr, /* DMA2 Stream 5 */
+		dma2_stream6_isr, /* DMA2 Stream 6 */
+		dma2_stream7_isr, /* DMA2 Stream 7 */
+		usart6_isr, /* USART6 */
+		i2c3_ev_isr, /* I2C3 Event */
+		i2c3_er_isr, /* I2C3 Error */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		fpu_isr, /* FPU */
+		nullptr, /* Reserved */
+		nullptr, /* Reserved */
+		spi4_isr, /* SPI4 */
+		spi5_isr, /* SPI5 */
+	}
+};
+
+void irqReset() noexcept
+{
+	// The firmware is built for the hardware FPU, so it must be turned on before anything can touch it
+	SCB_CPACR = SCB_CPACR | (SCB_CPACR_FULL * (SCB_CPACR_CP10 | SCB_CPACR_CP11));
+	__asm__ volatile("dsb\n\tisb" ::: "memory");
+
+	auto *src{&beginDataLoad};
+	for (auto *dst{&beginData}; dst < &endData; ++dst, ++src)
+		*dst = *src;
+	for (auto *dst{&beginBSS}; dst < &endBSS; ++dst)
+		*dst = 0;
+	for (auto *ctor{&beginCtors}; ctor != &endCtors; ++ctor)
+		(*ctor)();
+
+	static_cast<void>(runMain(0, nullptr));
+	// main() only returns to ask for a restart, which the debugger does for us - so wait for it here
+	while (true)
+		__asm__("bkpt #0");
+}
+
+void irqHardFault() noexcept
+{
+	/* Get some information about the fault for the debugger.. */
+	__asm__(R"(
+		mov     r0, #4
+		mov     r1, lr
+		tst     r0, r1
+		beq     _MSP
+		mrs     r0, psp
+		b       _HALT
+	_MSP:
+		mrs     r0, msp
+	_HALT:
+		ldr     r1, [r0, #0x00] /* r0 */
+		ldr     r2, [r0, #0x04] /* r1 */
+		ldr     r3, [r0, #0x08] /* r2 */
+		ldr     r4, [r0, #0x0C] /* r3 */
+		ldr     r5, [r0, #0x10] /* r12 */
+		ldr     r6, [r0, #0x14] /* lr */
+		ldr     r7, [r0, #0x1C] /* xpsr */
+		mov     r8, r7
+		ldr     r7, [r0, #0x18] /* pc */
+		bkpt    #0
+	_DEADLOOP:
+		b		_DEADLOOP
+	)");
+	/* The lowest 8 bits of r8 (xpsr) contain which handler triggered this, if there is a signal handler frame before this. */
+}
+
+void irqUnhandled() noexcept
+{
+	while (true)
+		continue;
+}
@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include "statistics.hxx"
+#include "hostConsole.hxx"
+
+using namespace std::literals::string_view_literals;
+
+namespace semihosting::statistics
+{
+	using host::console::host;
+
+	namespace
+	{
+		// Just enough 128-bit unsigned arithmetic for the variance calculation
+		struct Wide final
+		{
+			uint64_t high;
+			uint64_t low;
+		};
+
+		[[nodiscard]] Wide multiply(const uint64_t a, const uint64_t b) noexcept
+		{
+			const uint64_t aLow{static_cast<uint32_t>(a)};
+			const uint64_t aHigh{a >> 32U};
+			const uint64_t bLow{static_cast<uint32_t>(b)};
+			const uint64_t bHigh{b >> 32U};
+			const auto lowLow{aLow * bLow};
+			const auto lowHigh{aLow * bHigh};
+			const auto highLow{aHigh * bLow};
+			const auto middle{(lowLow >> 32U) + static_cast<uint32_t>(lowHigh) + static_cast<uint32_t>(highLow)};
+			return
+			{
+				(aHigh * bHigh) + (lowHigh >> 32U) + (highLow >> 32U) + (middle >> 32U),
+				(middle << 32U) | static_cast<uint32_t>(lowLow),
+			};
+		}
+
+		[[nodiscard]] Wide subtract(const Wide &a, const Wide &b) noexcept
+			{ return {a.high - b.high - (a.low < b.low ? 1U : 0U), a.low - b.low}; }
+
+		// Long division by a 32-bit divisor, a 32-bit digit at a time, so every step fits in 64 bits
+		[[nodiscard]] Wide divide(const Wide &dividend, const uint32_t divisor) noexcept
+		{
+			const std::array<uint32_t, 4> digits
+			{{
+				static_cast<uint32_t>(dividend.high >> 32U),
+				static_cast<uint32_t>(dividend.high),
+				static_cast<uint32_t>(dividend.low >> 32U),
+				static_cast<uint32_t>(dividend.low),
+			}};
+			std::array<uint32_t, 4> quotient{};
+			uint64_t remainder{0U};
+			for (size_t digit{0U}; digit < digits.size(); ++digit)
+			{
+				const auto value{(remainder << 32U) | digits[digit]};
+				quotient[digit] = static_cast<uint32_t>(value / divisor);
+				remainder = value % divisor;
+			}
+			return
+			{
+				(uint64_t{quotient[0]} << 32U) | quotient[1],
+				(uint64_t{quotient[2]} << 32U) | quotient[3],
+			};
+		}
+
+		[[nodiscard]] uint32_t squareRoot(const uint64_t value) noexcept
+		{
+			// Bit-by-bit integer square root, rounding down
+			uint64_t remaining{value};
+			uint64_t root{0U};
+			uint64_t bit{uint64_t{1U} << 62U};
+			while (bit > remaining)
+				bit >>= 2U;
+			while (bit)
+			{
+				if (remaining >= root + bit)
+				{
+					remaining -= root + bit;
+					root = (root >> 1U) + bit;
+				}
+				else
+					root >>= 1U;
+				bit >>= 2U;
+			}
+			return static_cast<uint32_t>(root);
+		}
+	} // namespace
+
+	void RunningStats::add(const uint32_t sample) noexcept
+	{
+		if (_count == maxSamples)
+			return;
+		if (!_count)
+			_origin = sample;
+		++_count;
+		_min = std::min(_min, sample);
+		_max = std::max(_max, sample);
+		const auto offset{static_cast<int64_t>(sample) - static_cast<int64_t>(_origin)};
+		_sum += offset;
+		// |offset| < 2^32, so its square always fits in 64 bits
+		const auto magnitude{static_cast<uint64_t>(offset < 0 ? -offset : offset)};
+		const auto square{magnitude * magnitude};
+		_sumSquaresLow += square;
+		if (_sumSquaresLow < square)
+			++_sumSquaresHigh;
+	}
+
+	uint32_t RunningStats::mean() const noexcept
+	{
+		if (!_count)
+			return 0U;
+		const auto magnitude{static_cast<uint64_t>(_sum < 0 ? -_sum : _sum)};
+		const auto offset{static_cast<int64_t>((magnitude + (_count / 2U)) / _count)};
+		return static_cast<uint32_t>(static_cast<int64_t>(_origin) + (_sum < 0 ? -offset : offset));
+	}
+
+	uint64_t RunningStats::variance() const noexcept
+	{
+		if (_count < 2U)
+			return 0U;
+		// (sum of squares - sum^2 / n) / (n - 1), with everything about the origin so the result is unchanged
+		const auto magnitude{static_cast<uint64_t>(_sum < 0 ? -_sum : _sum)};
+		const auto correction{divide(multiply(magnitude, magnitude), _count)};
+		const auto deviations{subtract({_sumSquaresHigh, _sumSquaresLow}, correction)};
+		// The variance of 32-bit samples is at most 2^62, so only the low half of the quotient can be set
+		return divide(deviations, _count - 1U).low;
+	}
+
+	uint32_t RunningStats::standardDeviation() const noexcept
+		{ return squareRoot(variance()); }
+
+	int64_t P2Quantile::parabolic(const size_t marker, const int32_t direction) const noexcept
+	{
+		const auto below{_positions[marker] - _positions[marker - 1U]};
+		const auto above{_positions[marker + 1U] - _positions[marker]};
+		// Slopes of the segments either side of the marker, with the heights' 8 fractional bits
+		const auto slopeAbove{(_heights[marker + 1U] - _heights[marker]) / above};
+		const auto slopeBelow{(_heights[marker] - _heights[marker - 1U]) / below};
+		const auto adjustment{(slopeAbove * (below + direction)) + (slopeBelow * (above - direction))};
+		return _heights[marker] + (direction * adjustment) / (below + above);
+	}
+
+	int64_t P2Quantile::linear(const size_t marker, const int32_t direction) const noexcept
+	{
+		const auto neighbour{static_cast<size_t>(static_cast<int32_t>(marker) + direction)};
+		return _heights[marker] + (direction * (_heights[neighbour] - _heights[marker])) /
+			(_positions[neighbour] - _positions[marker]);
+	}
+
+	void P2Quantile::add(const uint32_t sample) noexcept
+	{
+		const auto height{static_cast<int64_t>(sample) << 8U};
+		if (_count < markers)
+		{
+			// Until there are enough samples to place the markers, just keep them (in order)
+			auto index{_count++};
+			for (; index && _heights[index - 1U] > height; --index)
+				_heights[index] = _heights[index - 1U];
+			_heights[index] = height;
+			if (_count == markers)
+			{
+				_positions = {{1, 2, 3, 4, 5}};
+				_desired = {{1U << 16U, (1U << 16U) + (2U * _quantile), (1U << 16U) + (4U * _quantile),
+					(3U << 16U) + (2U * _quantile), 5U << 16U}};
+				_increments = {{0U, _quantile / 2U, _quantile, ((1U << 16U) + _quantile) / 2U, 1U << 16U}};
+			}
+			return;
+		}
+		if (_count == maxSamples)
+			return;
+		++_count;
+
+		// Find the cell the sample falls in, stretching the end markers out to it if it's a new extreme
+		size_t cell{0U};
+		if (height < _heights[0U])
+			_heights[0U] = height;
+		else if (height >= _heights[markers - 1U])
+		{
+			_heights[markers - 1U] = height;
+			cell = markers - 2U;
+		}
+		else
+		{
+			while (height >= _heights[cell + 1U])
+				++cell;
+		}
+		for (size_t marker{cell + 1U}; marker < markers; ++marker)
+			++_positions[marker];
+		for (size_t marker{0U}; marker < markers; ++marker)
+			_desired[marker] += _increments[marker];
+
+		// Move any of the middle markers that have drifted a whole position or more from where they should be
+		for (size_t marker{1U}; marker < markers - 1U; ++marker)
+		{
+			const auto drift{static_cast<int64_t>(_desired[marker]) - (int64_t{_positions[marker]} << 16U)};
+			if ((drift >= (1 << 16) && _positions[marker + 1U] - _positions[marker] > 1) ||
+				(drift <= -(1 << 16) && _positions[marker - 1U] - _positions[marker] < -1))
+			{
+				const int32_t direction{drift < 0 ? -1 : 1};
+				const auto candidate{parabolic(marker, direction)};
+				// Fall back to linear interpolation if the parabola would put the marker out of order
+				if (_heights[marker - 1U] < candidate && candidate < _heights[marker + 1U])
+					_heights[marker] = candidate;
+				else
+					_heights[marker] = linear(marker, direction);
+				_positions[marker] += direction;
+			}
+		}
+	}
+
+	uint32_t P2Quantile::value() const noexcept
+	{
+		if (!_count)
+			return 0U;
+		// With fewer than 5 samples, they are all still here in order - pick the nearest rank
+		if (_count < markers)
+		{
+			const auto rank{((uint64_t{_count - 1U} * _quantile) + (1U << 15U)) >> 16U};
+			return static_cast<uint32_t>(_heights[rank] >> 8U);
+		}
+		return static_cast<uint32_t>((_heights[2U] + (1 << 7)) >> 8U);
+	}
+
+	size_t LogHistogram::bucketFor(const uint32_t sample) noexcept
+	{
+		constexpr uint32_t subBuckets{1U << subBucketBits};
+		if (sample < subBuckets)
+			return sample;
+		const auto msb{31U - static_cast<uint32_t>(__builtin_clz(sample))};
+		const auto subBucket{(sample >> (msb - subBucketBits)) & (subBuckets - 1U)};
+		return ((msb - subBucketBits + 1U) << subBucketBits) | subBucket;
+	}
+
+	uint32_t LogHistogram::lowerBound(const size_t bucket) noexcept
+	{
+		constexpr uint32_t subBuckets{1U << subBucketBits};
+		if (bucket < subBuckets)
+			return static_cast<uint32_t>(bucket);
+		const auto group{static_cast<uint32_t>(bucket >> subBucketBits)};
+		const auto subBucket{static_cast<uint32_t>(bucket) & (subBuckets - 1U)};
+		return (subBuckets | subBucket) << (group - 1U);
+	}
+
+	void Summary::add(const uint32_t sample) noexcept
+	{
+		_stats.add(sample);
+		_median.add(sample);
+		_p90.add(sample);
+		_p99.add(sample);
+		_histogram.add(sample);
+	}
+
+	void Summary::report(const std::string_view benchmark, const std::string_view metric) const noexcept
+	{
+		host.result(benchmark, metric, "count"sv, _stats.count());
+		host.result(benchmark, metric, "min"sv, _stats.min());
+		host.result(benchmark, metric, "max"sv, _stats.max());
+		host.result(benchmark, metric, "mean"sv, _stats.mean());
+		host.result(benchmark, metric, "stddev"sv, _stats.standardDeviation());
+		host.result(benchmark, metric, "p50"sv, median());
+		host.result(benchmark, metric, "p90"sv, p90());
+		host.result(benchmark, metric, "p99"sv, p99());
+		for (size_t bucket{0U}; bucket < LogHistogram::bucketCount; ++bucket)
+		{
+			if (_histogram.count(bucket))
+				host.result(benchmark, metric, "histogram"sv, LogHistogram::lowerBound(bucket), _histogram.count(bucket));
+		}
+	}
+} // namespace semihosting::statistics
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STATISTICS_HXX
+#define STATISTICS_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+
+namespace semihosting::statistics
+{
+	/*
+	 * Count, min, max, mean and variance of a stream of samples, kept exactly in integer arithmetic. The sums
+	 * are taken about the first sample so they stay small for the tightly clustered timings benchmarks produce.
+	 * Each offset from the first sample is under 2^32 either way, so it is the 64-bit signed sum of offsets that
+	 * sets the limit - it can't overflow for up to maxSamples (2^31) samples, whereas the 128-bit sum of squares
+	 * has room for far more. Samples past maxSamples are ignored.
+	 */
+	struct RunningStats final
+	{
+	public:
+		constexpr static uint32_t maxSamples{1U << 31U};
+
+	private:
+		uint32_t _count{0U};
+		uint32_t _min{UINT32_MAX};
+		uint32_t _max{0U};
+		uint32_t _origin{0U};
+		int64_t _sum{0};
+		uint64_t _sumSquaresLow{0U};
+		uint64_t _sumSquaresHigh{0U};
+
+	public:
+		void add(uint32_t sample) noexcept;
+
+		[[nodiscard]] uint32_t count() const noexcept { return _count; }
+		[[nodiscard]] uint32_t min() const noexcept { return _count ? _min : 0U; }
+		[[nodiscard]] uint32_t max() const noexcept { return _max; }
+		// The mean, rounded to the nearest whole value
+		[[nodiscard]] uint32_t mean() const noexcept;
+		// The sample (n - 1) variance, rounded down
+		[[nodiscard]] uint64_t variance() const noexcept;
+		[[nodiscard]] uint32_t standardDeviation() const noexcept;
+	};
+
+	/*
+	 * Jain and Chlamtac's P² estimator for a single quantile. Five markers track the minimum, the quantile, the
+	 * maximum and the points half way between, moving along the sorted stream as samples arrive - so no samples
+	 * are stored. Marker heights are fixed point with 8 fractional bits. Past maxSamples the markers stop moving,
+	 * which keeps the interpolation within 64 bits, and the estimate holds where it had got to.
+	 */
+	struct P2Quantile final
+	{
+	public:
+		constexpr static uint32_t maxSamples{1U << 21U};
+
+	private:
+		constexpr static size_t markers{5U};
+
+		// The quantile as a fraction with 16 fractional bits
+		uint32_t _quantile;
+		uint32_t _count{0U};
+		std::array<int64_t, markers> _heights{};
+		std::array<int32_t, markers> _positions{};
+		// Where each marker should be, and how far that moves per sample, with 16 fractional bits
+		std::array<uint64_t, markers> _desired{};
+		std::array<uint32_t, markers> _increments{};
+
+		[[nodiscard]] int64_t parabolic(size_t marker, int32_t direction) const noexcept;
+		[[nodiscard]] int64_t linear(size_t marker, int32_t direction) const noexcept;
+
+	public:
+		// Track the quantile `permille` thousandths of the way up the distribution (500 for the median)
+		constexpr P2Quantile(const uint32_t permille) noexcept :
+			_quantile{static_cast<uint32_t>((uint64_t{permille} << 16U) / 1000U)} { }
+
+		void add(uint32_t sample) noexcept;
+		// The current estimate, or the exact quantile while there are still fewer than 5 samples
+		[[nodiscard]] uint32_t value() const noexcept;
+	};
+
+	/*
+	 * Counts samples into buckets a quarter of a power of two wide, so every bucket's lower bound is within
+	 * 25% of every sample in it. Values below 8 each get their own bucket.
+	 */
+	struct LogHistogram final
+	{
+	public:
+		constexpr static uint32_t subBucketBits{2U};
+		constexpr static size_t bucketCount{(32U - subBucketBits + 1U) << subBucketBits};
+
+	private:
+		std::array<uint32_t, bucketCount> _counts{};
+
+	public:
+		[[nodiscard]] static size_t bucketFor(uint32_t sample) noexcept;
+		[[nodiscard]] static uint32_t lowerBound(size_t bucket) noexcept;
+
+		void add(const uint32_t sample) noexcept { ++_counts[bucketFor(sample)]; }
+		[[nodiscard]] uint32_t count(const size_t bucket) const noexcept { return _counts[bucket]; }
+	};
+
+	// Everything above for one metric, so a benchmark can keep its samples on target and report a summary
+	struct Summary final
+	{
+	private:
+		RunningStats _stats{};
+		P2Quantile _median{500U};
+		P2Quantile _p90{900U};
+		P2Quantile _p99{990U};
+		LogHistogram _histogram{};
+
+	public:
+		void add(uint32_t sample) noexcept;
+
+		[[nodiscard]] const RunningStats &stats() const noexcept { return _stats; }
+		[[nodiscard]] uint32_t median() const noexcept { return _median.value(); }
+		[[nodiscard]] uint32_t p90() const noexcept { return _p90.value(); }
+		[[nodiscard]] uint32_t p99() const noexcept { return _p99.value(); }
+		[[nodiscard]] const LogHistogram &histogram() const noexcept { return _histogram; }
+
+		// Emit `[#] <benchmark> <metric> <statistic> <value>` lines for count, min, max, mean, stddev, p50, p90 and
+		// p99, then `[#] <benchmark> <metric> histogram <lower bound> <count>` for each non-empty bucket
+		void report(std::string_view benchmark, std::string_view metric) const noexcept;
+	};
+} // namespace semihosting::statistics
+
+#endif /*STATISTICS_HXX*/
@@ -34,6 +34,7 @@
 #define SYSCALL_TYPES_HXX
 
 #include <cstdint>
+#include <cstddef>
 
 namespace semihosting::types
 {
@@ -63,6 +64,8 @@ namespace semihosting::types
 		exitExtended = 0x20U,
 		elapsed = 0x30U,
 		tickFrequency = 0x31U,
+		// Vendor-defined operations (0x100-0x1ff)
+		batch = 0x100U,
 	};
 
 	enum class OpenMode : uint8_t
@@ -143,6 +146,28 @@ namespace semihosting::types
 		fileNameTooLong = 91,
 	};
 
+	/*
+	 * One entry in the descriptor list handed to Syscall::batch. The debugger runs the entries in order, each
+	 * exactly as if it had been made on its own with params as its parameter block - except that if resultFrom
+	 * names an earlier entry, that entry's result is first written over params[0] (so a write can use the FD an
+	 * earlier open returned). It fills in result, and the errno left behind if the operation returned -1.
+	 * Running stops after the first operation to return -1, and the call returns how many entries were run.
+	 * Syscall::exit, Syscall::exitExtended and Syscall::batch itself cannot be batched.
+	 */
+	struct BatchOperation
+	{
+		Syscall syscall;
+		uintptr_t *params;
+		int32_t resultFrom;
+		int32_t result;
+		FileIOErrno error;
+	};
+
+	// A debugger supporting Syscall::batch sets this bit in the byte following the standard
+	// features byte of `:semihosting-features`
+	constexpr static size_t featureBatchByte{1U};
+	constexpr static uint8_t featureBatch{0x01U};
+
 	enum class ExitReason : uint32_t
 	{
 		// Hardware exceptions
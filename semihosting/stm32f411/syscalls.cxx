@@ -30,11 +30,21 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <sys/types.h>
 #include <array>
 #include "syscalls.hxx"
 #include "syscallTypes.hxx"
+#include "ramfunc.hxx"
+#ifdef INTERRUPT_LOAD_MODE
+#include "irqLoad.hxx"
+#endif
+#ifdef SEMIHOSTING_TRACE
+#include "trace.hxx"
+#endif
+#ifndef SEMIHOSTING_STANDIN
+#include "perfScope.hxx"
+#endif
 
+using namespace std::literals::string_view_literals;
 using namespace semihosting::types;
 
 /*
@@ -45,7 +55,8 @@ using namespace semihosting::types;
  * the breakpoint instruction and we just have to return to wherever the program counter
  * was after from the link register value.
  */
-[[gnu::naked, gnu::noinline]] static int32_t semihostingSyscall([[maybe_unused]] const Syscall syscall,
+#ifndef SEMIHOSTING_STANDIN
+[[gnu::naked, gnu::noinline, RAMFUNC]] static int32_t semihostingTrap([[maybe_unused]] const Syscall syscall,
 	[[maybe_unused]] const void *const paramsPtr) noexcept
 {
 	__asm__ volatile(R"(
@@ -53,6 +64,38 @@ using namespace semihosting::types;
 		bx lr
 	)");
 }
+#else
+// When built for the Linux stand-in (tools/semihostingStandin), calls go to its emulation of the debugger instead
+int32_t semihostingStandin(Syscall syscall, const void *paramsPtr) noexcept;
+
+static inline int32_t semihostingTrap(const Syscall syscall, const void *const paramsPtr) noexcept
+	{ return semihostingStandin(syscall, paramsPtr); }
+#endif
+
+// Every call halts the core, so when running under interrupt load, account for what each halt costs the load.
+// When tracing, every call also gets recorded along with its parameters and result
+static inline int32_t semihostingSyscall(const Syscall syscall, const void *const paramsPtr) noexcept
+{
+#ifdef SEMIHOSTING_TRACE
+	semihosting::trace::begin(syscall, paramsPtr);
+#endif
+	int32_t result{};
+	{
+#ifdef INTERRUPT_LOAD_MODE
+		const semihosting::irqLoad::HaltScope scope{};
+#endif
+#ifndef SEMIHOSTING_STANDIN
+		// The core's side of the trap is only a handful of cycles, as CYCCNT stops while the host services the
+		// call, so unlike the test-sized regions this one is short enough to get exact event counts for
+		const semihosting::perf::PerfScope trapScope{"syscall.trap"sv};
+#endif
+		result = semihostingTrap(syscall, paramsPtr);
+	}
+#ifdef SEMIHOSTING_TRACE
+	semihosting::trace::end(result);
+#endif
+	return result;
+}
 
 template<typename T, size_t N> static int32_t semihostingSyscall(const Syscall syscall,
 	const std::array<T, N> &params) noexcept
@@ -122,9 +165,9 @@ namespace semihosting
 
 	int32_t seek(const int32_t fd, const uint32_t offset) noexcept
 	{
-		std::array<uint32_t, 2> params
+		const std::array<uintptr_t, 2> params
 		{{
-			static_cast<uint32_t>(fd),
+			static_cast<uintptr_t>(fd),
 			offset,
 		}};
 		return semihostingSyscall(Syscall::seek, params);
@@ -213,9 +256,9 @@ namespace semihosting
 
 	void exit(const ExitReason reason, const uint32_t statusCode) noexcept
 	{
-		const std::array<uint32_t, 2> params
+		const std::array<uintptr_t, 2> params
 		{{
-			static_cast<uint32_t>(reason),
+			static_cast<uintptr_t>(reason),
 			statusCode,
 		}};
 		semihostingSyscall(Syscall::exitExtended, params);
@@ -229,16 +272,82 @@ namespace semihosting
 
 	int32_t tickFrequency() noexcept
 		{ return semihostingSyscall(Syscall::tickFrequency, nullptr); }
-} // namespace semihosting
 
-// These stubs turn off the newlib components we don't care about like `kill()` and `getpid()`
-extern "C"
-{
-	/* NOLINTNEXTLINE(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
-	pid_t _getpid()
-		{ return 1; }
+	enum class BatchSupport : uint8_t
+	{
+		unknown,
+		supported,
+		unsupported,
+	};
 
-	/* NOLINTNEXTLINE(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp) */
-	int _kill([[maybe_unused]] const int pid, [[maybe_unused]] const int signal)
-		{ return 0; }
-}
+	static BatchSupport batchSupport{BatchSupport::unknown};
+
+	[[nodiscard]] static BatchSupport probeBatchSupport() noexcept
+	{
+		const auto fd{open(":semihosting-features"sv, OpenMode::readBinary)};
+		if (fd == -1)
+			return BatchSupport::unsupported;
+		// The magic number and standard features byte, then the byte the batch bit lives in. Debuggers that
+		// define further feature bytes make the file longer, so only the first few bytes matter here
+		std::array<uint8_t, 6> features{};
+		const auto length{fileLength(fd)};
+		const auto notRead{length >= static_cast<int32_t>(features.size()) ? read(fd, features) : -1};
+		static_cast<void>(close(fd));
+		if (notRead != 0)
+			return BatchSupport::unsupported;
+		return features[4U + featureBatchByte] & featureBatch ? BatchSupport::supported : BatchSupport::unsupported;
+	}
+
+	bool batchSupported() noexcept
+	{
+		if (batchSupport == BatchSupport::unknown)
+			batchSupport = probeBatchSupport();
+		return batchSupport == BatchSupport::supported;
+	}
+
+	// The exits take their parameter by value rather than as a block, and batches don't nest
+	[[nodiscard]] static bool batchable(const Syscall syscall) noexcept
+		{ return syscall != Syscall::exit && syscall != Syscall::exitExtended && syscall != Syscall::batch; }
+
+	size_t runBatch(const substrate::span<BatchOperation> operations) noexcept
+	{
+		// Anything not run is left marked as having failed
+		for (auto &operation : operations)
+		{
+			operation.result = -1;
+			operation.error = FileIOErrno::success;
+		}
+
+		if (batchSupported())
+		{
+			const std::array<uintptr_t, 2> params
+			{{
+				reinterpret_cast<uintptr_t>(operations.data()),
+				operations.size(),
+			}};
+			const auto result{semihostingSyscall(Syscall::batch, params)};
+			return result < 0 ? 0U : static_cast<size_t>(result);
+		}
+
+		// The debugger can't do it for us, so work through the list the same way it would have
+		for (size_t index{0U}; index < operations.size(); ++index)
+		{
+			auto &operation{operations[index]};
+			if (!batchable(operation.syscall) ||
+				(operation.resultFrom >= 0 && static_cast<size_t>(operation.resultFrom) >= index))
+			{
+				operation.error = FileIOErrno::argumentInvalid;
+				return index + 1U;
+			}
+			if (operation.resultFrom >= 0)
+				operation.params[0] = static_cast<uintptr_t>(operations[operation.resultFrom].result);
+			operation.result = semihostingSyscall(operation.syscall, operation.params);
+			if (operation.result == -1)
+			{
+				operation.error = lastErrno();
+				return index + 1U;
+			}
+		}
+		return operations.size();
+	}
+} // namespace semihosting
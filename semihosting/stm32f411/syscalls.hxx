@@ -69,6 +69,11 @@ namespace semihosting
 	void exit(types::ExitReason reason, uint32_t statusCode) noexcept;
 	[[nodiscard]] types::SemihostingResult elapsedTime(uint64_t &ticks) noexcept;
 	[[nodiscard]] int32_t tickFrequency() noexcept;
+	// Whether the debugger advertises Syscall::batch in `:semihosting-features` (checked once, then remembered)
+	[[nodiscard]] bool batchSupported() noexcept;
+	// Run a list of operations - in a single halt if the debugger supports Syscall::batch, otherwise one call at a
+	// time with the same semantics. Returns how many of the operations were run
+	[[nodiscard]] size_t runBatch(substrate::span<types::BatchOperation> operations) noexcept;
 
 	[[nodiscard]] static inline int32_t read(const int32_t fd, void *const dataPointer,
 		const size_t dataLength) noexcept
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <libopencm3/stm32/rcc.h>
+#include <substrate/span>
+#include "trace.hxx"
+#include "syscalls.hxx"
+#include "wallClock.hxx"
+
+using namespace semihosting::types;
+
+namespace semihosting::trace
+{
+	static std::array<TraceRecord, traceDepth> records{};
+	// Total calls recorded - the next record goes at recorded % traceDepth
+	static uint32_t recorded{0U};
+	// The call number of the most recent call to return -1, or UINT32_MAX if none has yet
+	static uint32_t lastFailure{UINT32_MAX};
+	// Set while dump() is writing out the trace, so its own calls don't get recorded over it
+	static bool suspended{false};
+
+	// Tack up to `length` bytes from the target buffer at `pointer` onto the end of the record's data
+	static void capture(TraceRecord &record, const uintptr_t pointer, const size_t length) noexcept
+	{
+		const auto amount{std::min<size_t>(length, maxData - record.dataLength)};
+		const auto *const buffer{reinterpret_cast<const uint8_t *>(pointer)};
+		std::copy_n(buffer, amount, record.data.begin() + record.dataLength);
+		record.dataLength += amount;
+	}
+
+	static void words(TraceRecord &record, const void *const params, const size_t count) noexcept
+	{
+		const auto *const block{static_cast<const uintptr_t *>(params)};
+		record.paramCount = count;
+		std::copy_n(block, count, record.params.begin());
+	}
+
+	// Pull out the parameters and outgoing data of the call, following the parameter layouts of syscalls.cxx
+	static void decode(TraceRecord &record, const Syscall syscall, const void *const params) noexcept
+	{
+		const auto *const block{static_cast<const uintptr_t *>(params)};
+		switch (syscall)
+		{
+			case Syscall::open:
+				words(record, params, 3U);
+				capture(record, block[0], block[2]);
+				break;
+			case Syscall::close:
+			case Syscall::isError:
+			case Syscall::isTTY:
+			case Syscall::fileLength:
+				record.paramCount = 1U;
+				record.params[0] = static_cast<uint32_t>(*static_cast<const int32_t *>(params));
+				break;
+			case Syscall::writeChar:
+				record.paramCount = 1U;
+				record.params[0] = *static_cast<const uint8_t *>(params);
+				break;
+			case Syscall::writeNulStr:
+			{
+				const std::string_view string{static_cast<const char *>(params)};
+				record.paramCount = 1U;
+				record.params[0] = string.length();
+				capture(record, reinterpret_cast<uintptr_t>(string.data()), string.length());
+				break;
+			}
+			case Syscall::write:
+				words(record, params, 3U);
+				capture(record, block[1], block[2]);
+				break;
+			case Syscall::read:
+			case Syscall::tempName:
+				words(record, params, 3U);
+				break;
+			case Syscall::seek:
+			case Syscall::readCommandLine:
+			case Syscall::exitExtended:
+			case Syscall::batch:
+				words(record, params, 2U);
+				break;
+			case Syscall::remove:
+			case Syscall::system:
+				words(record, params, 2U);
+				capture(record, block[0], block[1]);
+				break;
+			case Syscall::rename:
+				words(record, params, 4U);
+				capture(record, block[0], block[1]);
+				capture(record, block[2], block[3]);
+				break;
+			case Syscall::exit:
+				// The reason is passed as the parameter pointer itself
+				record.paramCount = 1U;
+				record.params[0] = reinterpret_cast<uintptr_t>(params);
+				break;
+			default:
+				// Everything else takes no parameters, or only a block for the host to fill in
+				break;
+		}
+	}
+
+	void begin(const Syscall syscall, const void *const params) noexcept
+	{
+		if (suspended)
+			return;
+		auto &record{records[recorded % traceDepth]};
+		record = {};
+		record.syscall = syscall;
+		decode(record, syscall, params);
+		// Take the timestamp last so decoding doesn't count towards the call
+		record.timestamp = wallClock::now();
+	}
+
+	void end(const int32_t result) noexcept
+	{
+		if (suspended)
+			return;
+		const auto now{wallClock::now()};
+		auto &record{records[recorded % traceDepth]};
+		record.ticks = now - record.timestamp;
+		record.result = result;
+		// Give the errno the firmware just asked for to the call it belongs to, if that's still in the buffer
+		if (record.syscall == Syscall::lastErrno && lastFailure != UINT32_MAX &&
+			recorded - lastFailure < traceDepth)
+		{
+			records[lastFailure % traceDepth].error = static_cast<FileIOErrno>(result);
+			lastFailure = UINT32_MAX;
+		}
+		else if (result == -1)
+			lastFailure = recorded;
+		++recorded;
+	}
+
+	bool dump() noexcept
+	{
+		suspended = true;
+		const auto count{std::min<uint32_t>(recorded, traceDepth)};
+		const TraceHeader header
+		{
+			traceMagic,
+			traceVersion,
+			sizeof(TraceRecord),
+			count,
+			recorded - count,
+			rcc_ahb_frequency,
+		};
+		bool result{false};
+		const auto fd{open(traceFile, OpenMode::writeBinary)};
+		if (fd != -1)
+		{
+			result = write(fd, &header, sizeof(header)) == 0;
+			// Write the records out oldest first, which may mean starting part way round the ring
+			for (uint32_t index{recorded - count}; result && index != recorded; ++index)
+				result = write(fd, &records[index % traceDepth], sizeof(TraceRecord)) == 0;
+			result &= close(fd) == SemihostingResult::success;
+		}
+		suspended = false;
+		return result;
+	}
+} // namespace semihosting::trace
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TRACE_HXX
+#define TRACE_HXX
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+
+#include "syscallTypes.hxx"
+
+namespace semihosting::trace
+{
+	using namespace std::literals::string_view_literals;
+
+	constexpr static uint32_t traceMagic{0x52544853U}; // 'SHTR'
+	constexpr static uint32_t traceVersion{2U};
+	// How many of the most recent calls the ring buffer holds
+	constexpr static size_t traceDepth{64U};
+	constexpr static size_t maxParams{4U};
+	constexpr static size_t maxData{64U};
+	// The host file dump() writes the trace out to
+	constexpr static auto traceFile{"semihosting-trace.bin"sv};
+
+	// A dumped trace is this header followed by `count` TraceRecords, oldest first
+	struct TraceHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t recordSize;
+		uint32_t count;
+		// Calls that were recorded but had been overwritten by newer ones by the time of the dump
+		uint32_t dropped;
+		// What the record timestamps and durations count in, in Hz
+		uint32_t tickFrequency;
+	};
+
+	/*
+	 * One semihosting call. Everything is a 32-bit target word so the host can read dumps back as-is. The
+	 * call's errno isn't asked for by the recorder (that would be another call, changing what's traced) - it's
+	 * filled in when the firmware itself calls SYS_ERRNO while this is the most recent call to have failed.
+	 */
+	struct TraceRecord
+	{
+		// The wall clock when the call was made, and how many ticks it took - halts included, so this is the
+		// whole of the call as the target saw it, host side and all
+		uint32_t timestamp;
+		uint32_t ticks;
+		types::Syscall syscall;
+		int32_t result;
+		types::FileIOErrno error;
+		// The call's parameter block - for calls taking a single value by address, that value. A SYS_BATCH
+		// record only holds the address and length of its descriptor list, not the operations in it
+		uint32_t paramCount;
+		std::array<uint32_t, maxParams> params;
+		// The leading bytes of the buffers handed to the host (paths, data written, commands), back to back
+		uint32_t dataLength;
+		std::array<uint8_t, maxData> data;
+	};
+
+	static_assert(sizeof(TraceHeader) == 24U);
+	static_assert(sizeof(TraceRecord) == 28U + (maxParams * 4U) + maxData);
+
+#ifdef SEMIHOSTING_TRACE
+	// Called by the syscall layer either side of each call
+	void begin(types::Syscall syscall, const void *params) noexcept;
+	void end(int32_t result) noexcept;
+	// Write the ring buffer out to traceFile on the host, returning false if that failed
+	[[nodiscard]] bool dump() noexcept;
+#endif
+} // namespace semihosting::trace
+
+#endif /*TRACE_HXX*/
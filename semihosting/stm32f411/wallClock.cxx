@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/dbgmcu.h>
+#include <libopencm3/cm3/nvic.h>
+#include "wallClock.hxx"
+
+namespace semihosting::wallClock
+{
+	// Written only by the interrupt handler
+	static volatile uint32_t wraps{0U};
+
+	void start() noexcept
+	{
+		// TIM5 is clocked at twice APB1 as APB1 is divided down from the core clock, so divide that
+		// back down to the core clock rate (which at 84MHz is no division at all)
+		const auto timerFrequency{rcc_apb1_frequency * 2U};
+
+		rcc_periph_clock_enable(RCC_TIM5);
+		// Keep the timer counting while the core is halted so halts show up in the figures
+		DBGMCU_APB1_FZ = DBGMCU_APB1_FZ & ~DBGMCU_APB1_FZ_DBG_TIM5_STOP;
+
+		timer_set_mode(TIM5, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+		timer_set_prescaler(TIM5, timerFrequency / rcc_ahb_frequency - 1U);
+		timer_set_period(TIM5, UINT32_MAX);
+		timer_continuous_mode(TIM5);
+		timer_set_counter(TIM5, 0U);
+		// The prescaler only loads on an update event, so force one rather than wait a whole wrap for it
+		timer_generate_event(TIM5, TIM_EGR_UG);
+		timer_clear_flag(TIM5, TIM_SR_UIF);
+		// Count the wraps at the lowest priority - there's a whole wrap (~51s) to get round to it
+		timer_enable_irq(TIM5, TIM_DIER_UIE);
+		nvic_set_priority(NVIC_TIM5_IRQ, 0xf0U);
+		nvic_enable_irq(NVIC_TIM5_IRQ);
+		timer_enable_counter(TIM5);
+	}
+
+	uint64_t now64() noexcept
+	{
+		uint32_t high{};
+		uint32_t low{};
+		bool pending{};
+		// Re-read if the interrupt counted a wrap while we were reading
+		do
+		{
+			high = wraps;
+			low = TIM_CNT(TIM5);
+			pending = TIM_SR(TIM5) & TIM_SR_UIF;
+		}
+		while (high != wraps);
+		// If we're running with the wrap interrupt held off, account for the wrap it has yet to count
+		if (pending && low < UINT32_MAX / 2U)
+			++high;
+		return (uint64_t{high} << 32U) | low;
+	}
+
+	uint64_t microseconds(const uint64_t ticks) noexcept
+		{ return ticks / (rcc_ahb_frequency / 1000000U); }
+} // namespace semihosting::wallClock
+
+void tim5_isr()
+{
+	TIM_SR(TIM5) = ~TIM_SR_UIF;
+	semihosting::wallClock::wraps = semihosting::wallClock::wraps + 1U;
+}
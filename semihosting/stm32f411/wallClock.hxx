@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WALL_CLOCK_HXX
+#define WALL_CLOCK_HXX
+
+#include <cstdint>
+#include <libopencm3/stm32/timer.h>
+
+/*
+ * A timebase for anything that wants to include the time spent in semihosting calls. The DWT cycle counter
+ * stops whenever the core is halted, so around a semihosting call it only sees the trap overhead - the host's
+ * side of the call is invisible to it. TIM5 is a 32-bit timer that we leave counting through debug halts,
+ * set to tick at the core clock rate so its figures can sit alongside cycle counts in the same units.
+ */
+namespace semihosting::wallClock
+{
+	// Start TIM5 free-running, for as long as the firmware runs
+	void start() noexcept;
+	// Ticks of the core clock since start(), halts included. This wraps after 2^32 ticks (~51s at 84MHz)
+	[[nodiscard]] inline uint32_t now() noexcept { return TIM_CNT(TIM5); }
+	// As now(), but extended to 64 bits by counting the wraps, for spans that may run longer than a wrap
+	[[nodiscard]] uint64_t now64() noexcept;
+	// Convert a span in ticks to microseconds
+	[[nodiscard]] uint64_t microseconds(uint64_t ticks) noexcept;
+} // namespace semihosting::wallClock
+
+#endif /*WALL_CLOCK_HXX*/
@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/dbgmcu.h>
+#include <libopencm3/cm3/scs.h>
+#include <libopencm3/cm3/dwt.h>
+
+/*
+ * This firmware benchmarks how quickly a probe can service scripted breakpoint/continue cycles. The loop in
+ * run_benchmark() calls breakpoint_site() (or writes watch_target) once per iteration, timestamping either side
+ * with both DWT CYCCNT and TIM2. CYCCNT stops while the core is halted, so its delta is the cost of a halt and
+ * resume as the core itself sees it; TIM2 keeps running through the halt, so its delta is the wall-clock time
+ * the probe took to service the hit and let the core go again.
+ *
+ * The host writes the mode and iteration count into `breakpoint_bench`, arms a hardware breakpoint on
+ * breakpoint_site (or a write watchpoint on watch_target) - or sets OPTION_SELF_ARM to have the firmware
+ * program the FPB/DWT comparator itself - then increments `sequence` and continues the target every time
+ * it halts. Once done, the firmware copies `sequence` into `completed`.
+ */
+
+#define DEFAULT_ITERATIONS 1000U
+
+#define LINEAR_BINS 64U
+#define LOG_BINS 26U /* Covers 2^6 through 2^31 cycles */
+
+/* FPB (v1, as on Cortex-M4) registers for when we arm the breakpoint ourselves */
+#define FPB_CTRL MMIO32(0xe0002000U)
+#define FPB_COMP0 MMIO32(0xe0002008U)
+#define FPB_CTRL_KEY (1U << 1U)
+#define FPB_CTRL_ENABLE (1U << 0U)
+#define FPB_COMP_REPLACE_LOWER (1U << 30U)
+#define FPB_COMP_REPLACE_UPPER (2U << 30U)
+#define FPB_COMP_ENABLE (1U << 0U)
+
+#define DWT_FUNCTION_WRITE 0x6U
+
+typedef enum bench_mode {
+	MODE_CALIBRATE = 0U,
+	MODE_BREAKPOINT = 1U,
+	MODE_WATCHPOINT = 2U,
+} bench_mode_e;
+
+#define OPTION_SELF_ARM (1U << 0U)
+
+/* Values below LINEAR_BINS cycles land in 1-cycle wide bins, larger values in power-of-two wide bins */
+typedef struct histogram {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t linear[LINEAR_BINS];
+	uint32_t logarithmic[LOG_BINS];
+} histogram_s;
+
+typedef struct breakpoint_bench {
+	uint32_t mode;
+	uint32_t iterations;
+	uint32_t options;
+	uint32_t sequence;
+	uint32_t completed;
+	/* Per-iteration overhead of the measurement loop with nothing armed, subtracted from every sample */
+	uint32_t baseline_core_cycles;
+	uint32_t baseline_wall_cycles;
+	/* Wall-clock time for the whole run, from which the host can derive hits per second */
+	uint64_t total_wall_cycles;
+	/* How many iterations did not halt at all (the breakpoint or watchpoint was not armed) */
+	uint32_t missed_hits;
+	histogram_s core_cycles;
+	histogram_s wall_cycles;
+} breakpoint_bench_s;
+
+volatile breakpoint_bench_s breakpoint_bench;
+/* The variable a watchpoint is placed on for MODE_WATCHPOINT */
+volatile uint32_t watch_target;
+
+static void clock_setup(void)
+{
+	/* Set processor to use the HSI at 84MHz - this leaves APB1 at 42MHz, so its timers are clocked at 84MHz */
+	rcc_clock_setup_pll(&rcc_hsi_configs[RCC_CLOCK_3V3_84MHZ]);
+	rcc_periph_clock_enable(RCC_TIM2);
+}
+
+static void timer_setup(void)
+{
+	/* TIM2 is a free running 32-bit up-counter at the core clock that keeps counting while the core is halted */
+	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_set_prescaler(TIM2, 0U);
+	timer_set_period(TIM2, UINT32_MAX);
+	timer_continuous_mode(TIM2);
+	DBGMCU_APB1_FZ &= ~DBGMCU_APB1_FZ_DBG_TIM2_STOP;
+	timer_enable_counter(TIM2);
+}
+
+static void histogram_reset(volatile histogram_s *const histogram)
+{
+	histogram->count = 0U;
+	histogram->min = UINT32_MAX;
+	histogram->max = 0U;
+	histogram->sum = 0U;
+	for (size_t bin = 0U; bin < LINEAR_BINS; ++bin)
+		histogram->linear[bin] = 0U;
+	for (size_t bin = 0U; bin < LOG_BINS; ++bin)
+		histogram->logarithmic[bin] = 0U;
+}
+
+static void histogram_add(volatile histogram_s *const histogram, const uint32_t value)
+{
+	++histogram->count;
+	histogram->sum += value;
+	if (value < histogram->min)
+		histogram->min = value;
+	if (value > histogram->max)
+		histogram->max = value;
+	if (value < LINEAR_BINS)
+		++histogram->linear[value];
+	else
+		/* LINEAR_BINS is 2^6, so the first log bin holds [2^6, 2^7) */
+		++histogram->logarithmic[(31U - (uint32_t)__builtin_clz(value)) - 6U];
+}
+
+/* The host puts a hardware breakpoint on this function for MODE_BREAKPOINT */
+__attribute__((noinline, used)) void breakpoint_site(void);
+__attribute__((noinline, used)) void breakpoint_site(void)
+{
+	__asm__ volatile("nop");
+}
+
+static void arm_breakpoint(void)
+{
+	const uint32_t address = (uint32_t)(uintptr_t)&breakpoint_site & ~1U;
+	/* FPBv1 compares on word addresses and uses the replace field to pick which halfword to break on */
+	FPB_COMP0 = (address & 0x1ffffffcU) | ((address & 2U) ? FPB_COMP_REPLACE_UPPER : FPB_COMP_REPLACE_LOWER) |
+		FPB_COMP_ENABLE;
+	FPB_CTRL = FPB_CTRL_KEY | FPB_CTRL_ENABLE;
+}
+
+static void arm_watchpoint(void)
+{
+	SCS_DEMCR |= SCS_DEMCR_TRCENA;
+	DWT_COMP(0) = (uint32_t)(uintptr_t)&watch_target;
+	DWT_MASK(0) = 2U; /* Match the whole 32-bit word */
+	DWT_FUNCTION(0) = DWT_FUNCTION_WRITE;
+}
+
+static void disarm(void)
+{
+	FPB_COMP0 = 0U;
+	FPB_CTRL = FPB_CTRL_KEY;
+	DWT_FUNCTION(0) = 0U;
+}
+
+/* Run the measurement loop once, returning the core and wall-clock cycles taken */
+static inline void __attribute__((always_inline)) measure_hit(const bench_mode_e mode, uint32_t *const core_cycles,
+	uint32_t *const wall_cycles)
+{
+	const uint32_t core_start = DWT_CYCCNT;
+	const uint32_t wall_start = TIM_CNT(TIM2);
+	if (mode == MODE_WATCHPOINT)
+		++watch_target;
+	else
+		breakpoint_site();
+	const uint32_t wall_end = TIM_CNT(TIM2);
+	const uint32_t core_end = DWT_CYCCNT;
+	*core_cycles = core_end - core_start;
+	*wall_cycles = wall_end - wall_start;
+}
+
+static void calibrate(const uint32_t iterations)
+{
+	uint64_t core_total = 0U;
+	uint64_t wall_total = 0U;
+	for (uint32_t iteration = 0U; iteration < iterations; ++iteration) {
+		uint32_t core_cycles = 0U;
+		uint32_t wall_cycles = 0U;
+		measure_hit(MODE_BREAKPOINT, &core_cycles, &wall_cycles);
+		core_total += core_cycles;
+		wall_total += wall_cycles;
+	}
+	breakpoint_bench.baseline_core_cycles = (uint32_t)(core_total / iterations);
+	breakpoint_bench.baseline_wall_cycles = (uint32_t)(wall_total / iterations);
+}
+
+static void run_benchmark(const bench_mode_e mode, const uint32_t iterations, const uint32_t options)
+{
+	histogram_reset(&breakpoint_bench.core_cycles);
+	histogram_reset(&breakpoint_bench.wall_cycles);
+	breakpoint_bench.missed_hits = 0U;
+
+	if (options & OPTION_SELF_ARM) {
+		if (mode == MODE_WATCHPOINT)
+			arm_watchpoint();
+		else
+			arm_breakpoint();
+	}
+
+	const uint32_t baseline_core = breakpoint_bench.baseline_core_cycles;
+	const uint32_t baseline_wall = breakpoint_bench.baseline_wall_cycles;
+	const uint32_t run_start = TIM_CNT(TIM2);
+	for (uint32_t iteration = 0U; iteration < iterations; ++iteration) {
+		uint32_t core_cycles = 0U;
+		uint32_t wall_cycles = 0U;
+		measure_hit(mode, &core_cycles, &wall_cycles);
+		core_cycles = core_cycles > baseline_core ? core_cycles - baseline_core : 0U;
+		wall_cycles = wall_cycles > baseline_wall ? wall_cycles - baseline_wall : 0U;
+		/* If the wall clock and core clock agree, the core never halted */
+		if (wall_cycles <= core_cycles)
+			++breakpoint_bench.missed_hits;
+		histogram_add(&breakpoint_bench.core_cycles, core_cycles);
+		histogram_add(&breakpoint_bench.wall_cycles, wall_cycles);
+	}
+	breakpoint_bench.total_wall_cycles = TIM_CNT(TIM2) - run_start;
+
+	if (options & OPTION_SELF_ARM)
+		disarm();
+}
+
+int main(void)
+{
+	clock_setup();
+	timer_setup();
+	dwt_enable_cycle_counter();
+
+	/* Work out what the loop costs with nothing armed so it can be subtracted out of the real runs */
+	calibrate(DEFAULT_ITERATIONS);
+	breakpoint_bench.mode = MODE_BREAKPOINT;
+	breakpoint_bench.iterations = DEFAULT_ITERATIONS;
+	breakpoint_bench.completed = breakpoint_bench.sequence;
+
+	while (true) {
+		/* Wait for the host to request a run */
+		if (breakpoint_bench.sequence == breakpoint_bench.completed)
+			continue;
+		const uint32_t sequence = breakpoint_bench.sequence;
+		const uint32_t mode = breakpoint_bench.mode;
+		const uint32_t iterations = breakpoint_bench.iterations;
+		if (mode == MODE_CALIBRATE && iterations)
+			calibrate(iterations);
+		else if ((mode == MODE_BREAKPOINT || mode == MODE_WATCHPOINT) && iterations)
+			run_benchmark((bench_mode_e)mode, iterations, breakpoint_bench.options);
+		breakpoint_bench.completed = sequence;
+	}
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/dma.h>
+
+/*
+ * This is a stub the probe loads into SRAM and runs to verify memory without reading it all back over SWD.
+ * The probe writes a request block somewhere in RAM, points r0 at it, sets up sp, and starts the stub at
+ * its load address. The stub sets status to STATUS_BUSY, does the work, fills in result and status, and
+ * then halts on a breakpoint so the probe only has to read one small block back.
+ *
+ * CRC mode feeds the range through the hardware CRC unit using DMA2 in memory-to-memory mode, so the
+ * result is the STM32 CRC32: polynomial 0x04c11db7, initial value 0xffffffff, 32-bit words processed
+ * MSb first with no reflection or final XOR. Any trailing 1-3 bytes are fed in as a final zero-padded
+ * little-endian word. Compare mode checks the range against a reference region word by word and reports
+ * the offset of the first mismatching byte.
+ *
+ * The stub keeps no global state and makes no calls outside itself, so it can be run from any word aligned
+ * SRAM address.
+ */
+
+#define CRC_DMA DMA2
+#define CRC_DMA_STREAM 0U
+/* NDTR is 16-bit, so large ranges have to be fed through in chunks */
+#define DMA_MAX_WORDS 65535U
+
+typedef enum crc_operation {
+	OPERATION_CRC32 = 1U,
+	OPERATION_COMPARE = 2U,
+} crc_operation_e;
+
+typedef enum crc_status {
+	STATUS_IDLE = 0U,
+	STATUS_BUSY = 1U,
+	/* CRC computed, or the regions compared equal */
+	STATUS_DONE = 2U,
+	/* The regions differ, result holds the offset of the first differing byte */
+	STATUS_MISMATCH = 3U,
+	STATUS_INVALID_OPERATION = 4U,
+	/* Addresses for CRC mode must be word aligned so DMA can read them */
+	STATUS_INVALID_ALIGNMENT = 5U,
+	/* The DMA controller reported a transfer error, typically from an address it cannot reach */
+	STATUS_DMA_ERROR = 6U,
+} crc_status_e;
+
+typedef struct crc_request {
+	uint32_t operation;
+	uint32_t address;
+	uint32_t length;
+	/* Start of the region to compare against, for OPERATION_COMPARE */
+	uint32_t reference;
+	volatile uint32_t status;
+	/* The CRC for OPERATION_CRC32, the offset of the first mismatch for OPERATION_COMPARE */
+	volatile uint32_t result;
+} crc_request_s;
+
+void crc_stub(crc_request_s *request) __attribute__((noreturn, section(".text.crc_stub")));
+
+static bool crc_dma_chunk(const uint32_t address, const uint32_t words)
+{
+	/* Peripheral port is the source in memory-to-memory mode, so walk it over the data and park the memory port on CRC_DR */
+	DMA_SPAR(CRC_DMA, CRC_DMA_STREAM) = (void *)(uintptr_t)address;
+	DMA_SM0AR(CRC_DMA, CRC_DMA_STREAM) = (void *)(uintptr_t)&CRC_DR;
+	DMA_SNDTR(CRC_DMA, CRC_DMA_STREAM) = words;
+	/* Memory-to-memory transfers are not allowed in direct mode, so use the FIFO */
+	DMA_SFCR(CRC_DMA, CRC_DMA_STREAM) = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_4_4_FULL;
+	DMA_LIFCR(CRC_DMA) = DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 |
+		DMA_LIFCR_CFEIF0;
+	DMA_SCR(CRC_DMA, CRC_DMA_STREAM) = DMA_SxCR_DIR_MEM_TO_MEM | DMA_SxCR_PINC | DMA_SxCR_PSIZE_32BIT |
+		DMA_SxCR_MSIZE_32BIT | DMA_SxCR_EN;
+
+	uint32_t flags = 0U;
+	do
+		flags = DMA_LISR(CRC_DMA);
+	while (!(flags & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0)));
+	DMA_SCR(CRC_DMA, CRC_DMA_STREAM) = 0U;
+	return !(flags & DMA_LISR_TEIF0);
+}
+
+static crc_status_e crc_range(crc_request_s *const request)
+{
+	if (request->address & 3U)
+		return STATUS_INVALID_ALIGNMENT;
+
+	RCC_AHB1ENR |= RCC_AHB1ENR_CRCEN | RCC_AHB1ENR_DMA2EN;
+	CRC_CR = CRC_CR_RESET;
+	/* Make sure the stream is idle before we reprogram it */
+	DMA_SCR(CRC_DMA, CRC_DMA_STREAM) = 0U;
+	while (DMA_SCR(CRC_DMA, CRC_DMA_STREAM) & DMA_SxCR_EN)
+		continue;
+
+	uint32_t address = request->address;
+	uint32_t words = request->length / 4U;
+	while (words) {
+		const uint32_t chunk = words > DMA_MAX_WORDS ? DMA_MAX_WORDS : words;
+		if (!crc_dma_chunk(address, chunk))
+			return STATUS_DMA_ERROR;
+		address += chunk * 4U;
+		words -= chunk;
+	}
+
+	const uint32_t trailing = request->length & 3U;
+	if (trailing) {
+		const volatile uint8_t *const bytes = (const volatile uint8_t *)(uintptr_t)address;
+		uint32_t word = 0U;
+		for (uint32_t offset = 0U; offset < trailing; ++offset)
+			word |= (uint32_t)bytes[offset] << (offset * 8U);
+		CRC_DR = word;
+	}
+
+	request->result = CRC_DR;
+	return STATUS_DONE;
+}
+
+static crc_status_e compare_range(crc_request_s *const request)
+{
+	const uint32_t length = request->length;
+	uint32_t offset = 0U;
+	/* Compare a word at a time while both sides are word aligned, dropping to bytes for the rest */
+	if (!((request->address | request->reference) & 3U)) {
+		const volatile uint32_t *const data = (const volatile uint32_t *)(uintptr_t)request->address;
+		const volatile uint32_t *const reference = (const volatile uint32_t *)(uintptr_t)request->reference;
+		for (; offset + 4U <= length; offset += 4U) {
+			if (data[offset / 4U] != reference[offset / 4U])
+				break;
+		}
+	}
+
+	const volatile uint8_t *const data = (const volatile uint8_t *)(uintptr_t)request->address;
+	const volatile uint8_t *const reference = (const volatile uint8_t *)(uintptr_t)request->reference;
+	for (; offset < length; ++offset) {
+		if (data[offset] != reference[offset]) {
+			request->result = offset;
+			return STATUS_MISMATCH;
+		}
+	}
+	request->result = length;
+	return STATUS_DONE;
+}
+
+void crc_stub(crc_request_s *const request)
+{
+	request->status = STATUS_BUSY;
+	request->result = 0U;
+
+	crc_status_e status = STATUS_INVALID_OPERATION;
+	if (request->operation == OPERATION_CRC32)
+		status = crc_range(request);
+	else if (request->operation == OPERATION_COMPARE)
+		status = compare_range(request);
+	request->status = status;
+
+	/* Hand control back to the probe */
+	while (true)
+		__asm__ volatile("bkpt #0");
+}
@@ -0,0 +1,401 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/dbgmcu.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/scs.h>
+#include <libopencm3/cm3/tpiu.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/itm.h>
+
+/*
+ * This firmware measures how an attached debug probe perturbs interrupt handling. TIM2 fires a compare
+ * interrupt every LOW_PRIORITY_PERIOD cycles and TIM3 an update interrupt every HIGH_PRIORITY_PERIOD cycles
+ * at a higher priority so it can preempt the TIM2 handler. Both timers run from the 84MHz timer clock with
+ * no prescaling, so a timer count is exactly one core cycle and the count at handler entry less the
+ * compare point is the entry latency. Handler entry is also timestamped with DWT CYCCNT to measure the
+ * period jitter between successive TIM2 interrupts as seen by the core.
+ *
+ * The host drives measurement runs through the `irq_latency` block: it writes the phase (which probe
+ * activity is being measured) and any options, then increments `sequence`. The firmware runs the requested
+ * activity in thread mode until `sample_count` TIM2 interrupts have been taken, fills in that phase's
+ * histograms, then copies `sequence` into `completed`. For the polling phase the host should poll target
+ * memory for the duration of the run - the firmware itself stays idle just as in the idle phase.
+ */
+
+#define SWO_BAUDRATE 115200U
+#define ARM_LAR_ACCESS_ENABLE 0xc5acce55U
+
+#define LOW_PRIORITY_PERIOD 8400U /* 10kHz at 84MHz */
+#define HIGH_PRIORITY_PERIOD 7919U /* ~10.6kHz, coprime with the TIM2 period so the two drift through each other */
+#define DEFAULT_SAMPLE_COUNT 10000U
+
+#define LINEAR_BINS 64U
+#define LOG_BINS 26U /* Covers 2^6 through 2^31 cycles */
+
+#define SEMIHOSTING_SYS_CLOCK 0x10U
+
+typedef enum probe_phase {
+	PHASE_IDLE = 0U,
+	PHASE_POLLING = 1U,
+	PHASE_SEMIHOSTING = 2U,
+	PHASE_SWO = 3U,
+	PHASE_COUNT
+} probe_phase_e;
+
+#define OPTION_NESTED (1U << 0U)
+
+/* Values below LINEAR_BINS cycles land in 1-cycle wide bins, larger values in power-of-two wide bins */
+typedef struct histogram {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t linear[LINEAR_BINS];
+	uint32_t logarithmic[LOG_BINS];
+} histogram_s;
+
+typedef struct phase_results {
+	/* Entry latency of the low priority (TIM2) handler */
+	histogram_s low_priority_latency;
+	/* Entry latency of the high priority (TIM3) handler, only populated for nested runs */
+	histogram_s high_priority_latency;
+	/* Absolute deviation of the time between successive TIM2 handler entries from the programmed period */
+	histogram_s low_priority_jitter;
+	/* How many TIM3 interrupts landed while the TIM2 handler was running */
+	uint32_t preemptions;
+	/* How many TIM2 periods went by without their handler running (missed interrupts) */
+	uint32_t overruns;
+	/*
+	 * CYCCNT does not count while the core is halted but TIM2 does, so the difference between the two across
+	 * successive handler entries is how long the probe kept the core halted for
+	 */
+	uint64_t halted_cycles;
+} phase_results_s;
+
+typedef struct irq_latency {
+	uint32_t phase;
+	uint32_t options;
+	uint32_t sample_count;
+	uint32_t sequence;
+	uint32_t completed;
+	phase_results_s results[PHASE_COUNT];
+} irq_latency_s;
+
+volatile irq_latency_s irq_latency;
+
+static volatile phase_results_s *active_results;
+static volatile uint32_t samples_taken;
+static volatile uint32_t samples_wanted;
+static volatile bool in_low_priority_handler;
+static uint32_t last_entry_cycles;
+static uint32_t last_entry_count;
+static bool have_last_entry;
+/* Set when the handler had to skip compare points, so the next entry is not one period on from the last */
+static bool resynchronised;
+
+static void clock_setup(void)
+{
+	/* Set processor to use the HSI at 84MHz - this leaves APB1 at 42MHz, so its timers are clocked at 84MHz */
+	rcc_clock_setup_pll(&rcc_hsi_configs[RCC_CLOCK_3V3_84MHZ]);
+
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_TIM2);
+	rcc_periph_clock_enable(RCC_TIM3);
+}
+
+static void gpio_setup(void)
+{
+	/* Set PA5 to 'output push-pull' so a scope can see handler activity */
+	gpio_mode_setup(GPIOA, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, GPIO5);
+}
+
+static void swo_setup(void)
+{
+	/* Enable tracing in DEMCR */
+	SCS_DEMCR |= SCS_DEMCR_TRCENA;
+
+	/* Get the active clock frequency of the core and use that to calculate a divisor */
+	const uint32_t divisor = (rcc_ahb_frequency / SWO_BAUDRATE) - 1U;
+	/* And configure the TPIU for 1-bit async trace (SWO) in Manchester coding */
+	TPIU_LAR = ARM_LAR_ACCESS_ENABLE;
+	TPIU_CSPSR = 1U; /* 1-bit mode */
+	TPIU_ACPR = divisor;
+	TPIU_SPPR = TPIU_SPPR_ASYNC_MANCHESTER;
+	/* Ensure that TPIU framing is off */
+	TPIU_FFCR &= ~TPIU_FFCR_ENFCONT;
+
+	/* Configure the DWT to provide the sync source for the ITM */
+	DWT_LAR = ARM_LAR_ACCESS_ENABLE;
+	DWT_CTRL |= 0x000003feU;
+	/* Enable access to the ITM registers and configure tracing output from the first stimulus port */
+	ITM_LAR = ARM_LAR_ACCESS_ENABLE;
+	ITM_TPR = 0x0000000fU;
+	ITM_TCR = ITM_TCR_ITMENA | ITM_TCR_SYNCENA | ITM_TCR_TXENA | ITM_TCR_SWOENA | (1U << 16U);
+	ITM_TER[0] = 1U;
+
+	/* Now tell the DBGMCU that we want trace enabled and mapped as SWO */
+	DBGMCU_CR &= ~DBGMCU_CR_TRACE_MODE_MASK;
+	DBGMCU_CR |= DBGMCU_CR_TRACE_IOEN | DBGMCU_CR_TRACE_MODE_ASYNC;
+}
+
+static void timer_setup(void)
+{
+	/* TIM2 is a free running 32-bit up-counter at the core clock, interrupting on channel 1 compare */
+	timer_set_mode(TIM2, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_set_prescaler(TIM2, 0U);
+	timer_set_period(TIM2, UINT32_MAX);
+	timer_continuous_mode(TIM2);
+
+	/* TIM3 reloads every HIGH_PRIORITY_PERIOD cycles, so its count at handler entry is the latency */
+	timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_set_prescaler(TIM3, 0U);
+	timer_set_period(TIM3, HIGH_PRIORITY_PERIOD - 1U);
+	timer_continuous_mode(TIM3);
+	timer_update_on_overflow(TIM3);
+
+	/* Lower numbers are more urgent - TIM3 must be able to preempt TIM2 */
+	nvic_set_priority(NVIC_TIM2_IRQ, 0x80U);
+	nvic_set_priority(NVIC_TIM3_IRQ, 0x40U);
+	nvic_enable_irq(NVIC_TIM2_IRQ);
+	nvic_enable_irq(NVIC_TIM3_IRQ);
+
+	/*
+	 * Deliberately leave the DBGMCU timer freeze bits clear - the timers keep running while the core is
+	 * halted, just as a production control loop's would, so time lost to a halt shows up as latency.
+	 */
+	DBGMCU_APB1_FZ &= ~(DBGMCU_APB1_FZ_DBG_TIM2_STOP | DBGMCU_APB1_FZ_DBG_TIM3_STOP);
+}
+
+static void histogram_reset(volatile histogram_s *const histogram)
+{
+	histogram->count = 0U;
+	histogram->min = UINT32_MAX;
+	histogram->max = 0U;
+	histogram->sum = 0U;
+	for (size_t bin = 0U; bin < LINEAR_BINS; ++bin)
+		histogram->linear[bin] = 0U;
+	for (size_t bin = 0U; bin < LOG_BINS; ++bin)
+		histogram->logarithmic[bin] = 0U;
+}
+
+static void histogram_add(volatile histogram_s *const histogram, const uint32_t value)
+{
+	++histogram->count;
+	histogram->sum += value;
+	if (value < histogram->min)
+		histogram->min = value;
+	if (value > histogram->max)
+		histogram->max = value;
+	if (value < LINEAR_BINS)
+		++histogram->linear[value];
+	else
+		/* LINEAR_BINS is 2^6, so the first log bin holds [2^6, 2^7) */
+		++histogram->logarithmic[(31U - (uint32_t)__builtin_clz(value)) - 6U];
+}
+
+void tim2_isr(void)
+{
+	const uint32_t entry_cycles = DWT_CYCCNT;
+	const uint32_t entry_count = TIM_CNT(TIM2);
+	in_low_priority_handler = true;
+	gpio_set(GPIOA, GPIO5);
+	timer_clear_flag(TIM2, TIM_SR_CC1IF);
+
+	const uint32_t compare = TIM_CCR1(TIM2);
+	volatile phase_results_s *const results = active_results;
+	if (results && samples_taken < samples_wanted) {
+		histogram_add(&results->low_priority_latency, entry_count - compare);
+		if (have_last_entry) {
+			const uint32_t period = entry_cycles - last_entry_cycles;
+			if (!resynchronised)
+				histogram_add(&results->low_priority_jitter,
+					period > LOW_PRIORITY_PERIOD ? period - LOW_PRIORITY_PERIOD : LOW_PRIORITY_PERIOD - period);
+			const uint32_t wall_period = entry_count - last_entry_count;
+			if (wall_period > period)
+				results->halted_cycles += wall_period - period;
+		}
+		++samples_taken;
+	}
+	last_entry_cycles = entry_cycles;
+	last_entry_count = entry_count;
+	have_last_entry = true;
+	resynchronised = false;
+
+	/*
+	 * Schedule the next compare. If the counter is already past it (the core was halted or held off for more
+	 * than a period), a compare written behind the counter would not match until it wraps ~51s later - so
+	 * step forward to the first period boundary still ahead of the counter, counting the skipped periods as
+	 * overruns. The counter is re-checked after each write in case it moved past while we were working it out
+	 */
+	uint32_t next_compare = compare + LOW_PRIORITY_PERIOD;
+	while (true) {
+		timer_set_oc_value(TIM2, TIM_OC1, next_compare);
+		const uint32_t late = TIM_CNT(TIM2) - next_compare;
+		if ((int32_t)late < 0)
+			break;
+		const uint32_t skipped = late / LOW_PRIORITY_PERIOD + 1U;
+		next_compare += skipped * LOW_PRIORITY_PERIOD;
+		if (results)
+			results->overruns += skipped;
+		/* Drop any match the stale compare raised so it's not taken for the new one */
+		timer_clear_flag(TIM2, TIM_SR_CC1IF);
+		resynchronised = true;
+	}
+
+	gpio_clear(GPIOA, GPIO5);
+	in_low_priority_handler = false;
+}
+
+void tim3_isr(void)
+{
+	const uint32_t entry_count = TIM_CNT(TIM3);
+	timer_clear_flag(TIM3, TIM_SR_UIF);
+
+	volatile phase_results_s *const results = active_results;
+	if (results && samples_taken < samples_wanted) {
+		histogram_add(&results->high_priority_latency, entry_count);
+		if (in_low_priority_handler)
+			++results->preemptions;
+	}
+}
+
+static uint32_t semihosting_clock(void)
+{
+	register uint32_t syscall __asm__("r0") = SEMIHOSTING_SYS_CLOCK;
+	register uint32_t params __asm__("r1") = 0U;
+	__asm__ volatile("bkpt #0xab" : "+r"(syscall) : "r"(params) : "memory");
+	return syscall;
+}
+
+static void itm_write(const uint8_t port, const char value)
+{
+	/* Wait for the port to become ready */
+	while ((ITM_STIM8(port) & 1U) == 0U)
+		continue;
+	/* Write the new character to the port */
+	ITM_STIM8(port) = (uint8_t)value;
+}
+
+/* Generate the probe activity for a phase until the run has collected enough samples */
+static void run_phase_activity(const probe_phase_e phase)
+{
+	char value = 'A';
+	while (samples_taken < samples_wanted) {
+		switch (phase) {
+		case PHASE_SEMIHOSTING:
+			/* Each semihosting call halts the core while the probe services it */
+			(void)semihosting_clock();
+			break;
+		case PHASE_SWO:
+			itm_write(0U, value);
+			value = value == 'Z' ? 'A' : (char)(value + 1);
+			break;
+		default:
+			/* Idle and polling phases leave the core spinning - any disturbance is down to the probe */
+			__asm__ volatile("nop");
+			break;
+		}
+	}
+}
+
+static void run_measurement(const probe_phase_e phase, const uint32_t options, const uint32_t sample_count)
+{
+	volatile phase_results_s *const results = &irq_latency.results[phase];
+	histogram_reset(&results->low_priority_latency);
+	histogram_reset(&results->high_priority_latency);
+	histogram_reset(&results->low_priority_jitter);
+	results->preemptions = 0U;
+	results->overruns = 0U;
+	results->halted_cycles = 0U;
+
+	samples_taken = 0U;
+	samples_wanted = sample_count;
+	have_last_entry = false;
+	resynchronised = false;
+	active_results = results;
+
+	/* Arm the first TIM2 compare a period from now, and TIM3 too if this is a nested run */
+	timer_set_counter(TIM2, 0U);
+	timer_set_oc_value(TIM2, TIM_OC1, LOW_PRIORITY_PERIOD);
+	timer_clear_flag(TIM2, TIM_SR_CC1IF);
+	timer_enable_irq(TIM2, TIM_DIER_CC1IE);
+	if (options & OPTION_NESTED) {
+		timer_set_counter(TIM3, 0U);
+		timer_clear_flag(TIM3, TIM_SR_UIF);
+		timer_enable_irq(TIM3, TIM_DIER_UIE);
+		timer_enable_counter(TIM3);
+	}
+	timer_enable_counter(TIM2);
+
+	run_phase_activity(phase);
+
+	timer_disable_counter(TIM2);
+	timer_disable_counter(TIM3);
+	timer_disable_irq(TIM2, TIM_DIER_CC1IE);
+	timer_disable_irq(TIM3, TIM_DIER_UIE);
+	active_results = NULL;
+}
+
+int main(void)
+{
+	/* Bring the clocks and peripherals needed up */
+	clock_setup();
+	gpio_setup();
+	swo_setup();
+	timer_setup();
+	dwt_enable_cycle_counter();
+
+	irq_latency.phase = PHASE_IDLE;
+	irq_latency.options = 0U;
+	irq_latency.sample_count = DEFAULT_SAMPLE_COUNT;
+	irq_latency.completed = irq_latency.sequence;
+
+	while (true) {
+		/* Wait for the host to request a measurement run */
+		if (irq_latency.sequence == irq_latency.completed)
+			continue;
+		const uint32_t sequence = irq_latency.sequence;
+		const uint32_t phase = irq_latency.phase;
+		const uint32_t sample_count = irq_latency.sample_count;
+		if (phase < PHASE_COUNT && sample_count)
+			run_measurement((probe_phase_e)phase, irq_latency.options, sample_count);
+		irq_latency.completed = sequence;
+	}
+
+	return 0;
+}
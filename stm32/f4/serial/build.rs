@@ -5,4 +5,14 @@ fn main()
     println!("cargo:rustc-link-arg-bins=--nmagic");
     println!("cargo:rustc-link-arg-bins=-Tlink.x");
     println!("cargo:rustc-link-arg-bins=-Tdefmt.x");
+
+    // The RTT bandwidth benchmark is configured through these at build time
+    for variable in
+    [
+        "RTT_BENCH_CHANNELS", "RTT_BENCH_BUFFER", "RTT_BENCH_BUFFER_1", "RTT_BENCH_BUFFER_2",
+        "RTT_BENCH_BUFFER_3", "RTT_BENCH_BUFFER_4", "RTT_BENCH_PACKET", "RTT_BENCH_MODE",
+    ]
+    {
+        println!("cargo:rerun-if-env-changed={variable}");
+    }
 }
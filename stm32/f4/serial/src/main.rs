@@ -5,20 +5,34 @@
 #![no_std]
 #![no_main]
 
+#[cfg(all(feature = "defmt-rtt", feature = "rtt-bandwidth"))]
+compile_error!("rtt-bandwidth provides its own defmt RTT channel, build with --no-default-features");
+
+#[cfg(feature = "rtt-bandwidth")]
+mod rttBench;
+
+#[cfg(not(feature = "rtt-bandwidth"))]
 use assign_resources::assign_resources;
+use embassy_stm32::{Config, Peripherals};
+// The benchmark build only uses the clock setup out of the UART exercise
+#[cfg(not(feature = "rtt-bandwidth"))]
 use embassy_stm32::
 {
-    Config, Peri, Peripherals, mode::Blocking, peripherals, usart::{self, Uart}
+    Peri, mode::Blocking, peripherals, usart::{self, Uart}
 };
 use embassy_executor::Spawner;
+#[cfg(not(feature = "rtt-bandwidth"))]
 use defmt::info;
 // Magically inject the parts of the defmt machinary that are needed for doing defmt over RTT 🙃
+#[cfg(feature = "defmt-rtt")]
 use defmt_rtt as _;
 // Magically inject #[panic_handler] so we get panic handling.. don't ask, it's absolutely magic how this can do that.
 use panic_probe as _;
 
+#[cfg(not(feature = "rtt-bandwidth"))]
 const UART_DATA: &'static str = "abcdefghijklmopqrstuvwxyz-0123456789_ABCDEFGHIJKLMNOPQRSTUVWXYZ=";
 
+#[cfg(not(feature = "rtt-bandwidth"))]
 assign_resources!
 {
 	uart: UartResources
@@ -61,6 +75,7 @@ fn systemInit() -> Peripherals
 	embassy_stm32::init(config)
 }
 
+#[cfg(not(feature = "rtt-bandwidth"))]
 fn uartInit(uart: UartResources) -> Uart<'static, Blocking>
 {
 	// Set up a configuration for this UART to run how we want it to
@@ -77,6 +92,7 @@ fn uartInit(uart: UartResources) -> Uart<'static, Blocking>
 		.expect("Failed to configure USART2")
 }
 
+#[cfg(not(feature = "rtt-bandwidth"))]
 #[embassy_executor::main]
 async fn main(_spawner: Spawner)
 {
@@ -96,3 +112,13 @@ async fn main(_spawner: Spawner)
 		info!("Block complete, looping");
 	}
 }
+
+#[cfg(feature = "rtt-bandwidth")]
+#[embassy_executor::main]
+async fn main(_spawner: Spawner)
+{
+	// Bring RTT up first so defmt has somewhere to go
+	let channels = rttBench::init();
+	let _peripherals = systemInit();
+	rttBench::run(channels);
+}
@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+//! RTT bandwidth benchmark - drives several RTT up channels as hard as the core can so the probe's RTT
+//! polling throughput and latency can be measured.
+//!
+//! Channel 0 carries defmt as usual (and the benchmark's reports). Channels 1 through `RTT_BENCH_CHANNELS`
+//! carry a continuous stream of fixed-size packets, each laid out little-endian as:
+//!
+//! | Offset | Size | Content                                                    |
+//! |--------|------|------------------------------------------------------------|
+//! | 0      | 4    | Per-channel sequence number                                |
+//! | 4      | 4    | DWT cycle count when the packet was handed to RTT          |
+//! | 8      | 1    | Channel number                                             |
+//! | 9      | 1    | Payload length                                             |
+//! | 10     | n    | Payload, counting up from the low byte of the sequence     |
+//!
+//! Sequence numbers advance whether or not the packet made it into the buffer, so the host can spot
+//! skipped packets as gaps. In trim mode packets may be cut short, so the stream is only good for raw
+//! byte counts there.
+//!
+//! Everything is picked at build time through the environment:
+//! * `RTT_BENCH_CHANNELS` - how many benchmark channels to drive (1 to 4, default 4)
+//! * `RTT_BENCH_BUFFER` - buffer size for every benchmark channel (default 1024)
+//! * `RTT_BENCH_BUFFER_1` .. `RTT_BENCH_BUFFER_4` - per-channel overrides of that buffer size
+//! * `RTT_BENCH_PACKET` - packet size including the header (10 to 255, default 64)
+//! * `RTT_BENCH_MODE` - `skip` (default), `trim` or `blocking`
+
+use cortex_m::peripheral::DWT;
+use defmt::info;
+use rtt_target::{ChannelMode, UpChannel, rtt_init};
+
+const MAX_CHANNELS: usize = 4;
+const HEADER_SIZE: usize = 10;
+
+/// Core clock as set up by systemInit() - HSI / 16 * 336 / 4
+const CORE_CLOCK: u32 = 84_000_000;
+/// Report the per-channel counters once a second
+const REPORT_INTERVAL: u32 = CORE_CLOCK;
+
+const ACTIVE_CHANNELS: usize = parseSize(option_env!("RTT_BENCH_CHANNELS"), MAX_CHANNELS);
+const BUFFER_SIZE: usize = parseSize(option_env!("RTT_BENCH_BUFFER"), 1024);
+const BUFFER_SIZE_1: usize = parseSize(option_env!("RTT_BENCH_BUFFER_1"), BUFFER_SIZE);
+const BUFFER_SIZE_2: usize = parseSize(option_env!("RTT_BENCH_BUFFER_2"), BUFFER_SIZE);
+const BUFFER_SIZE_3: usize = parseSize(option_env!("RTT_BENCH_BUFFER_3"), BUFFER_SIZE);
+const BUFFER_SIZE_4: usize = parseSize(option_env!("RTT_BENCH_BUFFER_4"), BUFFER_SIZE);
+const PACKET_SIZE: usize = parseSize(option_env!("RTT_BENCH_PACKET"), 64);
+const MODE: ChannelMode = parseMode(option_env!("RTT_BENCH_MODE"));
+
+const _: () = assert!(ACTIVE_CHANNELS >= 1 && ACTIVE_CHANNELS <= MAX_CHANNELS, "RTT_BENCH_CHANNELS must be 1 to 4");
+const _: () = assert!(PACKET_SIZE >= HEADER_SIZE && PACKET_SIZE <= 255, "RTT_BENCH_PACKET must be 10 to 255");
+const _: () = assert!
+(
+	BUFFER_SIZE_1 > PACKET_SIZE && BUFFER_SIZE_2 > PACKET_SIZE &&
+		BUFFER_SIZE_3 > PACKET_SIZE && BUFFER_SIZE_4 > PACKET_SIZE,
+	"RTT benchmark buffers must be bigger than a packet, as an RTT ring of N bytes only holds N - 1"
+);
+
+const fn parseSize(value: Option<&str>, default: usize) -> usize
+{
+	let Some(value) = value else { return default; };
+	let digits = value.as_bytes();
+	assert!(!digits.is_empty(), "RTT benchmark sizes must not be empty");
+
+	let mut result = 0;
+	let mut index = 0;
+	while index < digits.len()
+	{
+		assert!(digits[index].is_ascii_digit(), "RTT benchmark sizes must be decimal numbers");
+		result = result * 10 + (digits[index] - b'0') as usize;
+		index += 1;
+	}
+	result
+}
+
+const fn equal(lhs: &str, rhs: &str) -> bool
+{
+	let (lhs, rhs) = (lhs.as_bytes(), rhs.as_bytes());
+	if lhs.len() != rhs.len()
+	{
+		return false;
+	}
+
+	let mut index = 0;
+	while index < lhs.len()
+	{
+		if lhs[index] != rhs[index]
+		{
+			return false;
+		}
+		index += 1;
+	}
+	true
+}
+
+const fn parseMode(value: Option<&str>) -> ChannelMode
+{
+	match value
+	{
+		None => ChannelMode::NoBlockSkip,
+		Some(mode) if equal(mode, "skip") => ChannelMode::NoBlockSkip,
+		Some(mode) if equal(mode, "trim") => ChannelMode::NoBlockTrim,
+		Some(mode) if equal(mode, "blocking") => ChannelMode::BlockIfFull,
+		Some(_) => panic!("RTT_BENCH_MODE must be one of skip, trim or blocking"),
+	}
+}
+
+const fn modeName() -> &'static str
+{
+	match MODE
+	{
+		ChannelMode::NoBlockSkip => "skip",
+		ChannelMode::NoBlockTrim => "trim",
+		ChannelMode::BlockIfFull => "blocking",
+	}
+}
+
+#[derive(Clone, Copy, Default)]
+struct ChannelStats
+{
+	sequence: u32,
+	bytesWritten: u64,
+	bytesDropped: u64,
+	packetsDropped: u32,
+	maxWriteCycles: u32,
+}
+
+pub struct Channels
+{
+	bench: [UpChannel; MAX_CHANNELS],
+}
+
+/// Set up the RTT control block, handing channel 0 over to defmt. This must run before anything logs.
+pub fn init() -> Channels
+{
+	let channels = rtt_init!
+	{
+		up:
+		{
+			0: { size: 1024, mode: ChannelMode::NoBlockSkip, name: "defmt" }
+			1: { size: BUFFER_SIZE_1, mode: MODE, name: "bench1" }
+			2: { size: BUFFER_SIZE_2, mode: MODE, name: "bench2" }
+			3: { size: BUFFER_SIZE_3, mode: MODE, name: "bench3" }
+			4: { size: BUFFER_SIZE_4, mode: MODE, name: "bench4" }
+		}
+	};
+	rtt_target::set_defmt_channel(channels.up.0);
+
+	Channels { bench: [channels.up.1, channels.up.2, channels.up.3, channels.up.4] }
+}
+
+fn fillPacket(packet: &mut [u8; PACKET_SIZE], channel: u8, sequence: u32, timestamp: u32)
+{
+	let (header, payload) = packet.split_at_mut(HEADER_SIZE);
+	header[0..4].copy_from_slice(&sequence.to_le_bytes());
+	header[4..8].copy_from_slice(&timestamp.to_le_bytes());
+	header[8] = channel;
+	// PACKET_SIZE is checked to fit in a byte above
+	header[9] = (PACKET_SIZE - HEADER_SIZE).to_le_bytes()[0];
+
+	let seed = sequence.to_le_bytes()[0];
+	for (byte, offset) in payload.iter_mut().zip(0u8..)
+	{
+		*byte = seed.wrapping_add(offset);
+	}
+}
+
+fn report(stats: &mut [ChannelStats], elapsedCycles: u32)
+{
+	for (channel, stats) in (1..).zip(stats.iter_mut())
+	{
+		let bytesPerSecond = stats.bytesWritten * u64::from(CORE_CLOCK) / u64::from(elapsedCycles);
+		let droppedPerSecond = stats.bytesDropped * u64::from(CORE_CLOCK) / u64::from(elapsedCycles);
+		info!
+		(
+			"RTT channel {=u8}: {=u64} B/s written, {=u64} B/s dropped ({=u32} packets), seq {=u32}, max write {=u32} cycles",
+			channel, bytesPerSecond, droppedPerSecond, stats.packetsDropped, stats.sequence, stats.maxWriteCycles
+		);
+		// Keep the sequence number running across reports so the host sees one continuous stream
+		*stats = ChannelStats { sequence: stats.sequence, ..ChannelStats::default() };
+	}
+}
+
+/// Stream packets round-robin over the active benchmark channels forever, reporting once a second
+pub fn run(mut channels: Channels) -> !
+{
+	let mut core = cortex_m::Peripherals::take()
+		.expect("Core peripherals already taken");
+	core.DCB.enable_trace();
+	core.DWT.enable_cycle_counter();
+
+	info!
+	(
+		"Starting RTT bandwidth benchmark: {=usize} channels, {=usize} byte packets, {=str} mode, buffers {=usize}/{=usize}/{=usize}/{=usize}",
+		ACTIVE_CHANNELS, PACKET_SIZE, modeName(), BUFFER_SIZE_1, BUFFER_SIZE_2, BUFFER_SIZE_3, BUFFER_SIZE_4
+	);
+
+	let mut stats = [ChannelStats::default(); MAX_CHANNELS];
+	let mut packet = [0u8; PACKET_SIZE];
+	let mut lastReport = DWT::cycle_count();
+
+	loop
+	{
+		for ((channel, rtt), stats) in (1..).zip(channels.bench.iter_mut()).zip(stats.iter_mut()).take(ACTIVE_CHANNELS)
+		{
+			let start = DWT::cycle_count();
+			fillPacket(&mut packet, channel, stats.sequence, start);
+			// In blocking mode this is how long we waited on the probe to drain the buffer
+			let written = rtt.write(&packet);
+			let writeCycles = DWT::cycle_count().wrapping_sub(start);
+
+			stats.sequence = stats.sequence.wrapping_add(1);
+			stats.bytesWritten += written as u64;
+			if written < PACKET_SIZE
+			{
+				stats.bytesDropped += (PACKET_SIZE - written) as u64;
+				stats.packetsDropped += 1;
+			}
+			stats.maxWriteCycles = stats.maxWriteCycles.max(writeCycles);
+		}
+
+		let now = DWT::cycle_count();
+		let elapsed = now.wrapping_sub(lastReport);
+		if elapsed >= REPORT_INTERVAL
+		{
+			report(&mut stats[..ACTIVE_CHANNELS], elapsed);
+			lastReport = now;
+		}
+	}
+}
@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <libopencm3/stm32/memorymap.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/nvic.h>
+
+/*
+ * This firmware cycles the G0 through Sleep, Stop and Standby, with the DBGMCU low-power debug bits both
+ * clear and set, so we can see how long a probe takes to get access back after each kind of power
+ * transition. The RTC wakeup timer (clocked from the LSI, so it keeps running in every mode) brings the part
+ * back after `sleep_ms`. On each wake the firmware bumps `wake_count` in the record at the top of RAM and
+ * then waits for the host to write that value into `host_ack`. The time between the wake and the
+ * acknowledgement, as measured by TIM3, is the probe's re-attach latency for that phase.
+ *
+ * The record is in .noinit and SRAM retention is turned on for Standby, so it survives the reset a Standby
+ * exit causes. If no host acknowledges a wake within ACK_TIMEOUT_TICKS, the phase counts a timeout and the
+ * cycle carries on regardless.
+ */
+
+#define LOWPOWER_MAGIC 0x4c504f57U /* 'LPOW' */
+#define DEFAULT_SLEEP_MS 1000U
+
+/* TIM3 ticks at 10kHz from the 16MHz HSI, so latencies are measured in 100us units */
+#define LATENCY_TIMER_PRESCALER 1599U
+#define LATENCY_TICK_US 100U
+#define ACK_TIMEOUT_TICKS 60000U
+
+/* The RTC wakeup timer runs from RTCCLK / 16, which is 2kHz from the 32kHz LSI */
+#define RTC_WAKEUP_TICKS_PER_MS 2U
+
+/* G0 registers we need that are not covered by the timer and core headers */
+#define RCC_APBENR1 MMIO32(RCC_BASE + 0x3cU)
+#define RCC_APBENR1_TIM3EN (1U << 1U)
+#define RCC_APBENR1_RTCAPBEN (1U << 10U)
+#define RCC_APBENR1_DBGEN (1U << 27U)
+#define RCC_APBENR1_PWREN (1U << 28U)
+#define RCC_BDCR MMIO32(RCC_BASE + 0x5cU)
+#define RCC_BDCR_RTCSEL_MASK (3U << 8U)
+#define RCC_BDCR_RTCSEL_LSI (2U << 8U)
+#define RCC_BDCR_RTCEN (1U << 15U)
+#define RCC_CSR MMIO32(RCC_BASE + 0x60U)
+#define RCC_CSR_LSION (1U << 0U)
+#define RCC_CSR_LSIRDY (1U << 1U)
+
+#define PWR_CR1 MMIO32(PWR_BASE + 0x00U)
+#define PWR_CR1_LPMS_MASK (7U << 0U)
+#define PWR_CR1_LPMS_STOP0 (0U << 0U)
+#define PWR_CR1_LPMS_STANDBY (3U << 0U)
+#define PWR_CR1_DBP (1U << 8U)
+#define PWR_CR3 MMIO32(PWR_BASE + 0x08U)
+#define PWR_CR3_RRS (1U << 8U)
+#define PWR_CR3_EIWUL (1U << 15U)
+#define PWR_SR1 MMIO32(PWR_BASE + 0x10U)
+#define PWR_SR1_SBF (1U << 8U)
+#define PWR_SCR MMIO32(PWR_BASE + 0x18U)
+#define PWR_SCR_CWUF (0x3fU << 0U)
+#define PWR_SCR_CSBF (1U << 8U)
+
+#define RTC_ICSR MMIO32(RTC_BASE + 0x0cU)
+#define RTC_ICSR_WUTWF (1U << 2U)
+#define RTC_WUTR MMIO32(RTC_BASE + 0x14U)
+#define RTC_CR MMIO32(RTC_BASE + 0x18U)
+#define RTC_CR_WUCKSEL_RTC_DIV16 (0U << 0U)
+#define RTC_CR_WUCKSEL_MASK (7U << 0U)
+#define RTC_CR_WUTE (1U << 10U)
+#define RTC_CR_WUTIE (1U << 14U)
+#define RTC_WPR MMIO32(RTC_BASE + 0x24U)
+#define RTC_SCR MMIO32(RTC_BASE + 0x5cU)
+#define RTC_SCR_CWUTF (1U << 2U)
+#define RTC_TAMP_IRQ 2U
+
+#define EXTI_IMR1 MMIO32(EXTI_BASE + 0x80U)
+#define EXTI_LINE_RTC (1U << 19U)
+
+#define DBGMCU_CR MMIO32(0x40015804U)
+#define DBGMCU_CR_DBG_STOP (1U << 1U)
+#define DBGMCU_CR_DBG_STANDBY (1U << 2U)
+
+typedef enum lowpower_phase {
+	PHASE_SLEEP = 0U,
+	PHASE_STOP = 1U,
+	PHASE_STOP_DEBUG = 2U,
+	PHASE_STANDBY = 3U,
+	PHASE_STANDBY_DEBUG = 4U,
+	PHASE_COUNT,
+} lowpower_phase_e;
+
+typedef struct phase_result {
+	uint32_t wakes;
+	uint32_t timeouts;
+	/* Re-attach latencies, in microseconds */
+	uint32_t last_latency_us;
+	uint32_t min_latency_us;
+	uint32_t max_latency_us;
+	uint32_t total_latency_us;
+} phase_result_s;
+
+typedef struct lowpower_record {
+	uint32_t magic;
+	/* The phase we are in, or were in when a Standby exit reset us */
+	uint32_t phase;
+	/* How many times we have been through all the phases */
+	uint32_t cycles;
+	/* How long to stay in each low-power state, host writable */
+	uint32_t sleep_ms;
+	uint32_t wake_count;
+	/* The host writes wake_count here once it has access to the target again */
+	uint32_t host_ack;
+	phase_result_s results[PHASE_COUNT];
+} lowpower_record_s;
+
+volatile lowpower_record_s lowpower_record __attribute__((section(".noinit")));
+
+static void clock_setup(void)
+{
+	/* Run from the 16MHz HSI the part resets to, so no reconfiguration is needed after a Stop exit */
+	RCC_APBENR1 |= RCC_APBENR1_TIM3EN | RCC_APBENR1_RTCAPBEN | RCC_APBENR1_DBGEN | RCC_APBENR1_PWREN;
+	RCC_CSR |= RCC_CSR_LSION;
+	while (!(RCC_CSR & RCC_CSR_LSIRDY))
+		continue;
+	/* The RTC lives in the backup domain, so unlock that before selecting its clock */
+	PWR_CR1 |= PWR_CR1_DBP;
+	RCC_BDCR = (RCC_BDCR & ~RCC_BDCR_RTCSEL_MASK) | RCC_BDCR_RTCSEL_LSI | RCC_BDCR_RTCEN;
+}
+
+static void timer_setup(void)
+{
+	timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_set_prescaler(TIM3, LATENCY_TIMER_PRESCALER);
+	timer_set_period(TIM3, UINT16_MAX);
+	timer_continuous_mode(TIM3);
+	/* Load the prescaler now rather than at the first overflow */
+	timer_generate_event(TIM3, TIM_EGR_UG);
+	timer_enable_counter(TIM3);
+}
+
+static void rtc_wakeup_arm(const uint32_t sleep_ms)
+{
+	RTC_WPR = 0xcaU;
+	RTC_WPR = 0x53U;
+	RTC_CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	while (!(RTC_ICSR & RTC_ICSR_WUTWF))
+		continue;
+	uint32_t ticks = sleep_ms * RTC_WAKEUP_TICKS_PER_MS;
+	if (ticks == 0U)
+		ticks = 1U;
+	else if (ticks > UINT16_MAX + 1U)
+		ticks = UINT16_MAX + 1U;
+	RTC_WUTR = ticks - 1U;
+	RTC_CR = (RTC_CR & ~RTC_CR_WUCKSEL_MASK) | RTC_CR_WUCKSEL_RTC_DIV16 | RTC_CR_WUTE | RTC_CR_WUTIE;
+	RTC_SCR = RTC_SCR_CWUTF;
+	RTC_WPR = 0xffU;
+}
+
+static void rtc_wakeup_clear(void)
+{
+	RTC_SCR = RTC_SCR_CWUTF;
+	nvic_clear_pending_irq(RTC_TAMP_IRQ);
+}
+
+static void record_reset(void)
+{
+	lowpower_record.phase = PHASE_SLEEP;
+	lowpower_record.cycles = 0U;
+	lowpower_record.sleep_ms = DEFAULT_SLEEP_MS;
+	lowpower_record.wake_count = 0U;
+	lowpower_record.host_ack = 0U;
+	for (size_t phase = 0U; phase < PHASE_COUNT; ++phase) {
+		volatile phase_result_s *const result = &lowpower_record.results[phase];
+		result->wakes = 0U;
+		result->timeouts = 0U;
+		result->last_latency_us = 0U;
+		result->min_latency_us = UINT32_MAX;
+		result->max_latency_us = 0U;
+		result->total_latency_us = 0U;
+	}
+	lowpower_record.magic = LOWPOWER_MAGIC;
+}
+
+/* Note the wake and time how long it takes the host to acknowledge it */
+static void record_wake(const lowpower_phase_e phase)
+{
+	volatile phase_result_s *const result = &lowpower_record.results[phase];
+	const uint32_t wake = lowpower_record.wake_count + 1U;
+	timer_set_counter(TIM3, 0U);
+	lowpower_record.wake_count = wake;
+	++result->wakes;
+
+	uint32_t ticks = 0U;
+	while (lowpower_record.host_ack != wake) {
+		ticks = timer_get_counter(TIM3);
+		if (ticks >= ACK_TIMEOUT_TICKS) {
+			++result->timeouts;
+			return;
+		}
+	}
+	ticks = timer_get_counter(TIM3);
+
+	const uint32_t latency_us = ticks * LATENCY_TICK_US;
+	result->last_latency_us = latency_us;
+	result->total_latency_us += latency_us;
+	if (latency_us < result->min_latency_us)
+		result->min_latency_us = latency_us;
+	if (latency_us > result->max_latency_us)
+		result->max_latency_us = latency_us;
+}
+
+static void enter_low_power(const lowpower_phase_e phase)
+{
+	/* Set or clear the debug bits that keep the debug domain alive through this phase's low-power state */
+	if (phase == PHASE_STOP_DEBUG || phase == PHASE_STANDBY_DEBUG)
+		DBGMCU_CR |= DBGMCU_CR_DBG_STOP | DBGMCU_CR_DBG_STANDBY;
+	else
+		DBGMCU_CR &= ~(DBGMCU_CR_DBG_STOP | DBGMCU_CR_DBG_STANDBY);
+
+	rtc_wakeup_arm(lowpower_record.sleep_ms);
+	if (phase == PHASE_SLEEP)
+		SCB_SCR &= ~SCB_SCR_SLEEPDEEP;
+	else {
+		const uint32_t mode = phase == PHASE_STOP || phase == PHASE_STOP_DEBUG ? PWR_CR1_LPMS_STOP0 : PWR_CR1_LPMS_STANDBY;
+		PWR_CR1 = (PWR_CR1 & ~PWR_CR1_LPMS_MASK) | mode;
+		PWR_SCR = PWR_SCR_CWUF;
+		SCB_SCR |= SCB_SCR_SLEEPDEEP;
+	}
+	/* Interrupts are masked, so the RTC wakeup just ends the WFI without taking an interrupt */
+	__asm__ volatile("dsb\nwfi" ::: "memory");
+	SCB_SCR &= ~SCB_SCR_SLEEPDEEP;
+	rtc_wakeup_clear();
+}
+
+int main(void)
+{
+	clock_setup();
+	timer_setup();
+
+	__asm__ volatile("cpsid i");
+	nvic_enable_irq(RTC_TAMP_IRQ);
+	EXTI_IMR1 |= EXTI_LINE_RTC;
+	/* Keep SRAM (and so the record) powered through Standby, and let the RTC wake us from it */
+	PWR_CR3 |= PWR_CR3_RRS | PWR_CR3_EIWUL;
+
+	if (lowpower_record.magic != LOWPOWER_MAGIC || lowpower_record.phase >= PHASE_COUNT)
+		record_reset();
+	else if (PWR_SR1 & PWR_SR1_SBF) {
+		/* We are here because a Standby exit reset us - finish off the phase that was running */
+		PWR_SCR = PWR_SCR_CSBF | PWR_SCR_CWUF;
+		rtc_wakeup_clear();
+		record_wake((lowpower_phase_e)lowpower_record.phase);
+		lowpower_record.phase = (lowpower_record.phase + 1U) % PHASE_COUNT;
+		if (lowpower_record.phase == PHASE_SLEEP)
+			++lowpower_record.cycles;
+	} else
+		/* Any other reset restarts the run */
+		record_reset();
+
+	while (true) {
+		const lowpower_phase_e phase = (lowpower_phase_e)lowpower_record.phase;
+		enter_low_power(phase);
+		/* Standby exits via reset, so only Sleep and Stop (or a Standby the debugger kept us out of) get here */
+		record_wake(phase);
+		lowpower_record.phase = (phase + 1U) % PHASE_COUNT;
+		if (lowpower_record.phase == PHASE_SLEEP)
+			++lowpower_record.cycles;
+	}
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "baseline.hxx"
+
+namespace benchcompare
+{
+	Baseline::Baseline(const std::filesystem::path &directory, const std::string &target,
+		const std::string &probeVersion) : _path{directory / target / (probeVersion + ".baseline")} { }
+
+	bool Baseline::exists() const
+	{
+		std::error_code error{};
+		return std::filesystem::is_regular_file(_path, error);
+	}
+
+	bool Baseline::load(results_t &results) const
+	{
+		std::ifstream file{_path};
+		if (!file.is_open())
+			return false;
+		std::string line{};
+		while (std::getline(file, line))
+		{
+			const auto separator{line.find('\t')};
+			if (line.empty() || line[0] == '#' || separator == std::string::npos)
+				continue;
+			auto &samples{results[line.substr(0U, separator)]};
+			std::istringstream values{line.substr(separator + 1U)};
+			double value{};
+			while (values >> value)
+				samples.push_back(value);
+		}
+		return !file.bad();
+	}
+
+	bool Baseline::save(const results_t &results) const
+	{
+		std::error_code error{};
+		std::filesystem::create_directories(_path.parent_path(), error);
+		if (error)
+			return false;
+		// Write to a temporary file and rename it into place so an interrupted save can't lose the old baseline
+		auto temporaryPath{_path};
+		temporaryPath += ".tmp";
+		{
+			std::ofstream file{temporaryPath, std::ios::trunc};
+			if (!file.is_open())
+				return false;
+			file << std::setprecision(17);
+			for (const auto &[key, samples] : results)
+			{
+				file << key << '\t';
+				for (size_t index{0U}; index < samples.size(); ++index)
+					file << (index ? " " : "") << samples[index];
+				file << '\n';
+			}
+			if (!file.good())
+				return false;
+		}
+		std::filesystem::rename(temporaryPath, _path, error);
+		return !error;
+	}
+
+	bool validName(const std::string &name) noexcept
+	{
+		if (name.empty() || name == "." || name == "..")
+			return false;
+		for (const auto character : name)
+		{
+			const auto valid{(character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') ||
+				(character >= '0' && character <= '9') || character == '-' || character == '_' || character == '.' ||
+				character == '+'};
+			if (!valid)
+				return false;
+		}
+		return true;
+	}
+} // namespace benchcompare
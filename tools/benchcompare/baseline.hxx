@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BASELINE_HXX
+#define BASELINE_HXX
+
+#include <string>
+#include <filesystem>
+
+#include "resultLog.hxx"
+
+namespace benchcompare
+{
+	// Baselines are kept one file per target and probe version, as <directory>/<target>/<probeVersion>.baseline.
+	// Each line holds a result key, a tab, and then that key's samples separated by spaces.
+	struct Baseline final
+	{
+	private:
+		std::filesystem::path _path;
+
+	public:
+		Baseline(const std::filesystem::path &directory, const std::string &target, const std::string &probeVersion);
+
+		[[nodiscard]] const std::filesystem::path &path() const noexcept { return _path; }
+		[[nodiscard]] bool exists() const;
+		[[nodiscard]] bool load(results_t &results) const;
+		[[nodiscard]] bool save(const results_t &results) const;
+	};
+
+	// Target and probe version names become path components, so only allow a safe subset of characters
+	[[nodiscard]] bool validName(const std::string &name) noexcept;
+} // namespace benchcompare
+
+#endif /*BASELINE_HXX*/
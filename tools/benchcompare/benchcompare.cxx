@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <algorithm>
+
+#include "resultLog.hxx"
+#include "baseline.hxx"
+#include "metrics.hxx"
+#include "statistics.hxx"
+
+using namespace std::literals::string_view_literals;
+using namespace benchcompare;
+
+/*
+ * Compares benchmark results captured from the firmwares' consoles against stored baselines. Most results are
+ * costs (cycles, latency, bytes of stack) where a higher value is worse, but some are rates or limits where a
+ * lower value is worse, and some (buffer sizes, sample counts, histogram buckets) only describe the run - see
+ * metricDirection() for which is which. A key only counts as regressed when the candidate median moves the
+ * wrong way by more than both madThreshold scaled MADs of the baseline and minChange percent of the baseline
+ * median, so run-to-run noise and single outliers don't trip it. Descriptive keys are not compared at all.
+ */
+
+constexpr static int exitSuccess{0};
+constexpr static int exitRegression{1};
+constexpr static int exitFailure{2};
+
+struct options_t final
+{
+	std::string_view command{};
+	std::string target{};
+	std::string probeVersion{};
+	std::string baselineDirectory{"baselines"};
+	std::vector<std::string> logs{};
+	double madThreshold{3.0};
+	double minChangePercent{1.0};
+	size_t minSamples{3U};
+	bool replace{false};
+};
+
+static void usage(const char *const program)
+{
+	std::fprintf(stderr,
+		"Usage:\n"
+		"\t%s record --target <name> --probe <version> [--baseline-dir <dir>] [--replace] <log>...\n"
+		"\t%s compare --target <name> --probe <version> [--baseline-dir <dir>] [--mad-threshold <k>]\n"
+		"\t\t[--min-change <percent>] [--min-samples <n>] <log>...\n"
+		"\t%s show --target <name> --probe <version> [--baseline-dir <dir>]\n"
+		"\n"
+		"record adds the results in the logs to the baseline (or replaces it with --replace), compare checks the\n"
+		"results in the logs against the baseline and exits with 1 if any have regressed. Results that describe\n"
+		"the run rather than measure it (buffer sizes, sample counts and the like) are not compared.\n",
+		program, program, program);
+}
+
+[[nodiscard]] static std::optional<double> parseNumber(const char *const text)
+{
+	char *end{nullptr};
+	const auto value{std::strtod(text, &end)};
+	if (end == text || *end != '\0' || !std::isfinite(value) || value < 0.0)
+		return std::nullopt;
+	return value;
+}
+
+[[nodiscard]] static std::optional<options_t> parseArguments(const int argc, char **const argv)
+{
+	if (argc < 2)
+		return std::nullopt;
+	options_t options{};
+	options.command = argv[1];
+	if (options.command != "record"sv && options.command != "compare"sv && options.command != "show"sv)
+		return std::nullopt;
+
+	for (int index{2}; index < argc; ++index)
+	{
+		const std::string_view argument{argv[index]};
+		const auto hasValue{index + 1 < argc};
+		if (argument == "--replace"sv)
+			options.replace = true;
+		else if (argument == "--target"sv && hasValue)
+			options.target = argv[++index];
+		else if (argument == "--probe"sv && hasValue)
+			options.probeVersion = argv[++index];
+		else if (argument == "--baseline-dir"sv && hasValue)
+			options.baselineDirectory = argv[++index];
+		else if ((argument == "--mad-threshold"sv || argument == "--min-change"sv || argument == "--min-samples"sv) &&
+			hasValue)
+		{
+			const auto value{parseNumber(argv[++index])};
+			if (!value)
+				return std::nullopt;
+			if (argument == "--mad-threshold"sv)
+				options.madThreshold = *value;
+			else if (argument == "--min-change"sv)
+				options.minChangePercent = *value;
+			else
+				options.minSamples = std::max<size_t>(static_cast<size_t>(*value), 1U);
+		}
+		else if (!argument.empty() && argument[0] == '-')
+			return std::nullopt;
+		else
+			options.logs.emplace_back(argument);
+	}
+
+	if (!validName(options.target) || !validName(options.probeVersion))
+	{
+		std::fprintf(stderr, "A target and probe version made of [A-Za-z0-9._+-] are required\n");
+		return std::nullopt;
+	}
+	if (options.command != "show"sv && options.logs.empty())
+		return std::nullopt;
+	return options;
+}
+
+[[nodiscard]] static bool readLogs(const std::vector<std::string> &logs, results_t &results)
+{
+	for (const auto &log : logs)
+	{
+		if (!parseLog(log, results))
+		{
+			std::fprintf(stderr, "Failed to read log %s\n", log.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+[[nodiscard]] static int record(const options_t &options, const Baseline &baseline)
+{
+	results_t results{};
+	if (!options.replace && baseline.exists() && !baseline.load(results))
+	{
+		std::fprintf(stderr, "Failed to read baseline %s\n", baseline.path().c_str());
+		return exitFailure;
+	}
+	results_t captured{};
+	if (!readLogs(options.logs, captured))
+		return exitFailure;
+	size_t sampleCount{0U};
+	for (const auto &[key, samples] : captured)
+	{
+		auto &stored{results[key]};
+		stored.insert(stored.end(), samples.begin(), samples.end());
+		sampleCount += samples.size();
+	}
+	if (!baseline.save(results))
+	{
+		std::fprintf(stderr, "Failed to write baseline %s\n", baseline.path().c_str());
+		return exitFailure;
+	}
+	std::printf("Recorded %zu samples over %zu results into %s\n", sampleCount, captured.size(),
+		baseline.path().c_str());
+	return exitSuccess;
+}
+
+[[nodiscard]] static int compare(const options_t &options, const Baseline &baseline)
+{
+	results_t reference{};
+	if (!baseline.load(reference))
+	{
+		std::fprintf(stderr, "Failed to read baseline %s\n", baseline.path().c_str());
+		return exitFailure;
+	}
+	results_t candidate{};
+	if (!readLogs(options.logs, candidate))
+		return exitFailure;
+
+	size_t regressions{0U};
+	size_t improvements{0U};
+	size_t skipped{0U};
+	size_t informational{0U};
+	for (const auto &[key, samples] : candidate)
+	{
+		const auto direction{metricDirection(key)};
+		if (direction == Direction::informational)
+		{
+			++informational;
+			continue;
+		}
+		const auto match{reference.find(key)};
+		if (match == reference.end())
+		{
+			std::printf("NEW        %s: median %.0f (n=%zu)\n", key.c_str(), median(samples), samples.size());
+			continue;
+		}
+		const auto &baselineSamples{match->second};
+		if (baselineSamples.size() < options.minSamples)
+		{
+			std::printf("SKIPPED    %s: only %zu baseline samples, need %zu\n", key.c_str(), baselineSamples.size(),
+				options.minSamples);
+			++skipped;
+			continue;
+		}
+
+		const auto baselineMedian{median(baselineSamples)};
+		const auto spread{madScale * medianAbsoluteDeviation(baselineSamples)};
+		const auto candidateMedian{median(samples)};
+		const auto change{candidateMedian - baselineMedian};
+		// How far the candidate moved in the direction that makes it worse
+		const auto worsening{direction == Direction::higherIsBetter ? -change : change};
+		const auto limit{std::max(options.madThreshold * spread, std::fabs(baselineMedian) * options.minChangePercent / 100.0)};
+		const auto percent{baselineMedian != 0.0 ? change * 100.0 / baselineMedian : 0.0};
+
+		std::string_view verdict{"OK        "sv};
+		if (worsening > limit)
+		{
+			verdict = "REGRESSION"sv;
+			++regressions;
+		}
+		else if (-worsening > limit)
+		{
+			verdict = "IMPROVED  "sv;
+			++improvements;
+		}
+		std::printf("%.*s %s: baseline %.0f (MAD %.1f, n=%zu), candidate %.0f (n=%zu), %+.2f%%\n",
+			static_cast<int>(verdict.size()), verdict.data(), key.c_str(), baselineMedian, spread / madScale,
+			baselineSamples.size(), candidateMedian, samples.size(), percent);
+	}
+
+	std::printf("%zu regressions, %zu improvements, %zu skipped, %zu not compared\n", regressions, improvements,
+		skipped, informational);
+	return regressions ? exitRegression : exitSuccess;
+}
+
+[[nodiscard]] static int show(const Baseline &baseline)
+{
+	results_t results{};
+	if (!baseline.load(results))
+	{
+		std::fprintf(stderr, "Failed to read baseline %s\n", baseline.path().c_str());
+		return exitFailure;
+	}
+	for (const auto &[key, samples] : results)
+		std::printf("%s: median %.0f, MAD %.1f, n=%zu\n", key.c_str(), median(samples),
+			medianAbsoluteDeviation(samples), samples.size());
+	return exitSuccess;
+}
+
+int main(int argc, char **argv)
+{
+	const auto options{parseArguments(argc, argv)};
+	if (!options)
+	{
+		usage(argv[0]);
+		return exitFailure;
+	}
+	const Baseline baseline{options->baselineDirectory, options->target, options->probeVersion};
+	if (options->command == "record"sv)
+		return record(*options, baseline);
+	if (options->command == "compare"sv)
+		return compare(*options, baseline);
+	return show(baseline);
+}
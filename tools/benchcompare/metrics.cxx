@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <array>
+#include <algorithm>
+#include "metrics.hxx"
+
+using namespace std::literals::string_view_literals;
+
+namespace benchcompare
+{
+	struct metric_t final
+	{
+		// The benchmark the metric belongs to, or empty for a metric any benchmark can report
+		std::string_view benchmark;
+		std::string_view metric;
+		Direction direction;
+	};
+
+	constexpr static std::array<metric_t, 19U> metrics
+	{{
+		{"fdScaling"sv, "limit"sv, Direction::higherIsBetter},
+		{"fileThroughput"sv, "bufferSize"sv, Direction::informational},
+		{"mappedFile"sv, "fileSize"sv, Direction::informational},
+		{"mappedFile"sv, "residentLimit"sv, Direction::informational},
+		{"busContention"sv, "priority"sv, Direction::informational},
+		{"busContention"sv, "burst"sv, Direction::informational},
+		{"busLoad"sv, "bytes"sv, Direction::higherIsBetter},
+		{"busLoad"sv, "bytesPerSecond"sv, Direction::higherIsBetter},
+		{"batchedIO"sv, "batchSupported"sv, Direction::informational},
+		{"irqLoad"sv, "serviced"sv, Direction::higherIsBetter},
+		{"irqLoad"sv, "halts"sv, Direction::informational},
+		{"perf"sv, "calls"sv, Direction::informational},
+		{"perf"sv, "eventCalls"sv, Direction::informational},
+		{"perf"sv, "foldedInstructions"sv, Direction::higherIsBetter},
+		{"soak"sv, "boots"sv, Direction::informational},
+		{"soak"sv, "iterations"sv, Direction::informational},
+		{"soak"sv, "passes"sv, Direction::higherIsBetter},
+		// The sample count of a summary, and how its samples fall across the histogram buckets
+		{""sv, "count"sv, Direction::informational},
+		{""sv, "histogram"sv, Direction::informational},
+	}};
+
+	Direction metricDirection(std::string_view key) noexcept
+	{
+		const auto benchmarkEnd{key.find(' ')};
+		if (benchmarkEnd == std::string_view::npos)
+			return Direction::lowerIsBetter;
+		const auto benchmark{key.substr(0U, benchmarkEnd)};
+		key.remove_prefix(benchmarkEnd + 1U);
+
+		// Check each of the remaining tokens against the table, the first match winning
+		while (!key.empty())
+		{
+			const auto end{std::min(key.find(' '), key.size())};
+			const auto token{key.substr(0U, end)};
+			for (const auto &metric : metrics)
+			{
+				if ((metric.benchmark.empty() || metric.benchmark == benchmark) && metric.metric == token)
+					return metric.direction;
+			}
+			key.remove_prefix(std::min(end + 1U, key.size()));
+		}
+		return Direction::lowerIsBetter;
+	}
+} // namespace benchcompare
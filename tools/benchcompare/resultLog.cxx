@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include "resultLog.hxx"
+
+using namespace std::literals::string_view_literals;
+
+namespace benchcompare
+{
+	constexpr static auto resultMarker{"[#]"sv};
+
+	// Remove any ANSI escape sequences (the console colours its line prefixes) from a line
+	[[nodiscard]] static std::string stripEscapes(const std::string_view line)
+	{
+		std::string result{};
+		result.reserve(line.size());
+		for (size_t index{0U}; index < line.size(); ++index)
+		{
+			if (line[index] == '\x1b' && index + 1U < line.size() && line[index + 1U] == '[')
+			{
+				// Skip the CSI parameters up to and including the final byte
+				index += 2U;
+				while (index < line.size() && !(line[index] >= '@' && line[index] <= '~'))
+					++index;
+				continue;
+			}
+			if (line[index] != '\r')
+				result.push_back(line[index]);
+		}
+		return result;
+	}
+
+	[[nodiscard]] static std::vector<std::string_view> splitTokens(std::string_view text)
+	{
+		std::vector<std::string_view> tokens{};
+		while (!text.empty())
+		{
+			const auto start{text.find_first_not_of(" \t"sv)};
+			if (start == std::string_view::npos)
+				break;
+			text.remove_prefix(start);
+			const auto end{std::min(text.find_first_of(" \t"sv), text.size())};
+			tokens.push_back(text.substr(0U, end));
+			text.remove_prefix(end);
+		}
+		return tokens;
+	}
+
+	void parseLine(const std::string_view rawLine, results_t &results)
+	{
+		const auto line{stripEscapes(rawLine)};
+		const auto marker{line.find(resultMarker)};
+		if (marker == std::string::npos)
+			return;
+		const auto tokens{splitTokens(std::string_view{line}.substr(marker + resultMarker.size()))};
+		// We need at least a benchmark name and a value
+		if (tokens.size() < 2U)
+			return;
+
+		const std::string valueText{tokens.back()};
+		char *valueEnd{nullptr};
+		const auto value{std::strtod(valueText.c_str(), &valueEnd)};
+		if (valueEnd == valueText.c_str() || *valueEnd != '\0')
+			return;
+
+		std::string key{tokens.front()};
+		for (size_t index{1U}; index + 1U < tokens.size(); ++index)
+		{
+			key += ' ';
+			key += tokens[index];
+		}
+		results[key].push_back(value);
+	}
+
+	bool parseLog(const std::string &fileName, results_t &results)
+	{
+		std::ifstream file{fileName};
+		if (!file.is_open())
+			return false;
+		std::string line{};
+		while (std::getline(file, line))
+			parseLine(line, results);
+		return !file.bad();
+	}
+} // namespace benchcompare
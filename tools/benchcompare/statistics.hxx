@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STATISTICS_HXX
+#define STATISTICS_HXX
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace benchcompare
+{
+	// Scales the median absolute deviation so it estimates the standard deviation for normally distributed data
+	constexpr inline double madScale{1.4826};
+
+	[[nodiscard]] inline double median(std::vector<double> samples) noexcept
+	{
+		if (samples.empty())
+			return 0.0;
+		const auto middle{samples.size() / 2U};
+		std::nth_element(samples.begin(), samples.begin() + middle, samples.end());
+		const auto upper{samples[middle]};
+		if (samples.size() % 2U)
+			return upper;
+		// For an even count, the lower middle value is the largest of the values below `middle`
+		const auto lower{*std::max_element(samples.begin(), samples.begin() + middle)};
+		return (lower + upper) / 2.0;
+	}
+
+	// Median absolute deviation from the median - a spread measure that a few outliers can't drag around
+	[[nodiscard]] inline double medianAbsoluteDeviation(const std::vector<double> &samples) noexcept
+	{
+		const auto centre{median(samples)};
+		std::vector<double> deviations{};
+		deviations.reserve(samples.size());
+		for (const auto sample : samples)
+			deviations.push_back(std::fabs(sample - centre));
+		return median(std::move(deviations));
+	}
+} // namespace benchcompare
+
+#endif /*STATISTICS_HXX*/
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <array>
+#include <string_view>
+#include <substrate/span>
+
+#include "syscalls.hxx"
+#include "batch.hxx"
+#include "standin.hxx"
+
+using namespace std::literals::string_view_literals;
+using semihosting::types::OpenMode;
+using semihosting::types::FileIOErrno;
+using semihosting::types::SemihostingResult;
+
+/*
+ * Drives the firmware's semihosting library against the stand-in: writes a file as individual calls and as a
+ * batch, reads it back, and checks a failing batch stops where it should with the right errno, printing how
+ * many halts each took. Pass --no-batch to have the extension go unadvertised and check the fallback instead.
+ */
+
+constexpr static auto testFile{"semihosting-standin.bin"sv};
+constexpr static auto missingFile{"semihosting-standin-missing.bin"sv};
+constexpr static auto payload{"abcdefghijklmnopqrstuvwxyz\r\n"sv};
+
+constexpr static int exitSuccess{0};
+constexpr static int exitFailure{1};
+
+static bool expect(const bool condition, const char *const what) noexcept
+{
+	if (!condition)
+		std::fprintf(stderr, "FAIL: %s\n", what);
+	return condition;
+}
+
+[[nodiscard]] static substrate::span<const uint8_t> payloadBytes() noexcept
+	{ return {reinterpret_cast<const uint8_t *>(payload.data()), payload.size()}; }
+
+[[nodiscard]] static bool writeIndividually() noexcept
+{
+	standin::resetHalts();
+	const auto fd{semihosting::open(testFile, OpenMode::writeBinary)};
+	const auto result{fd != -1 && semihosting::write(fd, payloadBytes()) == 0 &&
+		semihosting::close(fd) == SemihostingResult::success};
+	std::printf("Individual open/write/close: %u halts\n", standin::halts());
+	return expect(result, "individual open/write/close");
+}
+
+[[nodiscard]] static bool writeBatched() noexcept
+{
+	semihosting::Batch<3> batch{};
+	const auto open{batch.open(testFile, OpenMode::writeBinary)};
+	const auto write{batch.write(open, payloadBytes())};
+	const auto close{batch.close(open)};
+	standin::resetHalts();
+	const auto result{batch.run()};
+	std::printf("Batched open/write/close: %u halts\n", standin::halts());
+	return expect(result && batch.result(open) > 0 && batch.result(write) == 0 && batch.result(close) == 0,
+		"batched open/write/close");
+}
+
+[[nodiscard]] static bool readBackBatched() noexcept
+{
+	std::array<uint8_t, payload.size()> data{};
+	semihosting::Batch<4> batch{};
+	const auto open{batch.open(testFile, OpenMode::readBinary)};
+	static_cast<void>(batch.seek(open, 0U));
+	const auto read{batch.read(open, data)};
+	static_cast<void>(batch.close(open));
+	const auto result{batch.run() && batch.result(read) == 0};
+	return expect(result && std::string_view{reinterpret_cast<const char *>(data.data()), data.size()} == payload,
+		"batched read back");
+}
+
+// A batch must stop at the first operation to fail, leave the rest marked as failed, and report the failure's errno
+[[nodiscard]] static bool failingBatch() noexcept
+{
+	std::array<uint8_t, 4> data{};
+	semihosting::Batch<3> batch{};
+	const auto open{batch.open(missingFile, OpenMode::readBinary)};
+	const auto read{batch.read(open, data)};
+	static_cast<void>(batch.close(open));
+	const auto ran{batch.run()};
+	return expect(!ran && batch.result(open) == -1 && batch.error(open) == FileIOErrno::noSuchEntity &&
+		batch.result(read) == -1 && batch.error(read) == FileIOErrno::success, "failing batch");
+}
+
+int main(int argc, char **argv)
+{
+	const auto advertise{!(argc > 1 && argv[1] == "--no-batch"sv)};
+	standin::advertiseBatch(advertise);
+	bool result{expect(semihosting::batchSupported() == advertise, "batch support detection")};
+	result &= writeIndividually();
+	result &= writeBatched();
+	result &= readBackBatched();
+	result &= failingBatch();
+	result &= expect(semihosting::remove(testFile) == SemihostingResult::success, "remove");
+	std::printf("%s (batch extension %s)\n", result ? "Passed" : "Failed", advertise ? "advertised" : "not advertised");
+	return result ? exitSuccess : exitFailure;
+}
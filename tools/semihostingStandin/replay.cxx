@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include <array>
+#include <optional>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "syscallTypes.hxx"
+#include "enumNames.hxx"
+#include "trace.hxx"
+
+using namespace std::literals::string_view_literals;
+using semihosting::types::Syscall;
+using semihosting::types::FileIOErrno;
+using semihosting::trace::TraceHeader;
+using semihosting::trace::TraceRecord;
+
+int32_t semihostingStandin(Syscall syscall, const void *paramsPtr) noexcept;
+
+/*
+ * Re-runs a trace dumped by a TRACE=1 build of the semihosting firmware against the stand-in, in the current
+ * directory, so a probe firmware regression can be pinned down without the probe in the loop. Each call's result
+ * (and errno, where the firmware asked for it) is checked against what the probe returned, where the result
+ * doesn't depend on the time or the machine, and per-call latencies are tallied for both sides.
+ *
+ * Calls on FDs opened before the trace starts can't be mapped to a local file - writes to them go to /dev/null
+ * so they are still timed, and anything else on them is skipped along with console input, SYS_SYSTEM, the exits
+ * and calls whose only effect is filling in a block for the target.
+ *
+ * SYS_BATCH calls are skipped too - the trace only records where the descriptor list was, not the operations in
+ * it - so any FDs a batch opened are unknown to the replay, and later calls on them are treated as above.
+ */
+
+constexpr static int exitSuccess{0};
+constexpr static int exitMismatch{1};
+constexpr static int exitFailure{2};
+
+struct callStats_t final
+{
+	uint32_t count{0U};
+	uint32_t skipped{0U};
+	uint32_t mismatches{0U};
+	double recordedMicroseconds{0.0};
+	double replayMicroseconds{0.0};
+};
+
+enum class Check : uint8_t
+{
+	// Don't run the call at all
+	skip,
+	// Run the call but the result depends on time or the host, so only time it
+	timeOnly,
+	// Run the call, and it must succeed or fail just as it did on the probe
+	success,
+	// Run the call, and it must return exactly what it did on the probe
+	exact,
+};
+
+[[nodiscard]] static Check checkFor(const Syscall syscall) noexcept
+{
+	switch (syscall)
+	{
+		case Syscall::open:
+		case Syscall::close:
+		case Syscall::seek:
+		case Syscall::remove:
+		case Syscall::rename:
+		case Syscall::tempName:
+			return Check::success;
+		case Syscall::write:
+		case Syscall::read:
+		case Syscall::isError:
+		case Syscall::fileLength:
+			return Check::exact;
+		case Syscall::writeChar:
+		case Syscall::writeNulStr:
+		case Syscall::isTTY:
+		case Syscall::clock:
+		case Syscall::time:
+		case Syscall::lastErrno:
+		case Syscall::elapsed:
+		case Syscall::tickFrequency:
+			return Check::timeOnly;
+		default:
+			return Check::skip;
+	}
+}
+
+[[nodiscard]] static std::string syscallName(const Syscall syscall)
+{
+	const auto name{semihosting::types::enumName(syscall)};
+	if (!name.empty())
+		return std::string{name};
+	std::array<char, 16> buffer{};
+	std::snprintf(buffer.data(), buffer.size(), "0x%03x", static_cast<uint32_t>(syscall));
+	return buffer.data();
+}
+
+[[nodiscard]] static bool readTrace(const char *const fileName, TraceHeader &header, std::vector<TraceRecord> &records)
+{
+	auto *const file{std::fopen(fileName, "rb")};
+	if (!file)
+	{
+		std::fprintf(stderr, "Could not open trace %s\n", fileName);
+		return false;
+	}
+	bool result{std::fread(&header, sizeof(header), 1U, file) == 1U};
+	if (!result || header.magic != semihosting::trace::traceMagic ||
+		header.version != semihosting::trace::traceVersion || header.recordSize != sizeof(TraceRecord))
+	{
+		std::fprintf(stderr, "%s is not a version %u semihosting trace\n", fileName, semihosting::trace::traceVersion);
+		std::fclose(file);
+		return false;
+	}
+	records.resize(header.count);
+	result = std::fread(records.data(), sizeof(TraceRecord), records.size(), file) == records.size();
+	std::fclose(file);
+	if (!result)
+		std::fprintf(stderr, "Trace %s is truncated\n", fileName);
+	return result;
+}
+
+struct Replayer final
+{
+private:
+	// The probe's FDs, to the FDs the stand-in gave out for the same opens
+	std::map<int32_t, int32_t> _fds{};
+	int32_t _nullFD{-1};
+	std::vector<uint8_t> _buffer{};
+
+	[[nodiscard]] std::string_view data(const TraceRecord &record, const size_t offset, const size_t length) const
+		noexcept
+	{
+		const auto available{offset < record.dataLength ? record.dataLength - offset : 0U};
+		return {reinterpret_cast<const char *>(record.data.data()) + offset, std::min<size_t>(length, available)};
+	}
+
+	[[nodiscard]] std::optional<int32_t> mapFD(const uint32_t probeFD, const bool isWrite) const noexcept
+	{
+		const auto fd{_fds.find(static_cast<int32_t>(probeFD))};
+		if (fd != _fds.end())
+			return fd->second;
+		if (isWrite)
+			return _nullFD;
+		return std::nullopt;
+	}
+
+	// Fill a buffer with the recorded data the call passed, padded out to its full length
+	[[nodiscard]] uintptr_t fill(const std::string_view recorded, const size_t length)
+	{
+		_buffer.assign(std::max<size_t>(length, 1U), 0U);
+		std::copy(recorded.begin(), recorded.end(), _buffer.begin());
+		return reinterpret_cast<uintptr_t>(_buffer.data());
+	}
+
+public:
+	Replayer() noexcept : _nullFD{::open("/dev/null", O_WRONLY)} { }
+	Replayer(const Replayer &) = delete;
+	Replayer(Replayer &&) = delete;
+	~Replayer() noexcept { ::close(_nullFD); }
+	Replayer &operator =(const Replayer &) = delete;
+	Replayer &operator =(Replayer &&) = delete;
+
+	// Run one recorded call against the stand-in, returning its result, or nothing if it can't be replayed
+	[[nodiscard]] std::optional<int32_t> replay(const TraceRecord &record)
+	{
+		std::array<uintptr_t, semihosting::trace::maxParams> block{};
+		std::copy(record.params.begin(), record.params.end(), block.begin());
+		int32_t value{};
+		const void *params{block.data()};
+		std::string path{};
+		std::string newPath{};
+
+		switch (record.syscall)
+		{
+			case Syscall::open:
+				path = data(record, 0U, record.params[2]);
+				block[0] = reinterpret_cast<uintptr_t>(path.data());
+				block[2] = path.length();
+				break;
+			case Syscall::close:
+			case Syscall::isTTY:
+			case Syscall::fileLength:
+			{
+				const auto fd{mapFD(record.params[0], false)};
+				if (!fd)
+					return std::nullopt;
+				value = *fd;
+				params = &value;
+				break;
+			}
+			case Syscall::isError:
+				value = static_cast<int32_t>(record.params[0]);
+				params = &value;
+				break;
+			case Syscall::writeChar:
+				value = static_cast<int32_t>(record.params[0]);
+				params = &value;
+				break;
+			case Syscall::writeNulStr:
+				path = data(record, 0U, record.params[0]);
+				params = path.c_str();
+				break;
+			case Syscall::write:
+			case Syscall::read:
+			case Syscall::seek:
+			{
+				const auto fd{mapFD(record.params[0], record.syscall == Syscall::write)};
+				if (!fd)
+					return std::nullopt;
+				block[0] = static_cast<uintptr_t>(*fd);
+				if (record.syscall != Syscall::seek)
+					block[1] = fill(record.syscall == Syscall::write ? data(record, 0U, record.params[2]) : ""sv,
+						record.params[2]);
+				break;
+			}
+			case Syscall::tempName:
+				block[0] = fill({}, record.params[2]);
+				break;
+			case Syscall::remove:
+				path = data(record, 0U, record.params[1]);
+				block[0] = reinterpret_cast<uintptr_t>(path.data());
+				block[1] = path.length();
+				break;
+			case Syscall::rename:
+				path = data(record, 0U, record.params[1]);
+				newPath = data(record, path.length(), record.params[3]);
+				block = {{reinterpret_cast<uintptr_t>(path.data()), path.length(),
+					reinterpret_cast<uintptr_t>(newPath.data()), newPath.length()}};
+				break;
+			case Syscall::elapsed:
+			{
+				static uint64_t ticks{};
+				params = &ticks;
+				break;
+			}
+			default:
+				break;
+		}
+
+		const auto result{semihostingStandin(record.syscall, params)};
+		if (record.syscall == Syscall::open && record.result != -1 && result != -1)
+			_fds[record.result] = result;
+		else if (record.syscall == Syscall::close && result != -1)
+			_fds.erase(static_cast<int32_t>(record.params[0]));
+		return result;
+	}
+};
+
+int main(int argc, char **argv)
+{
+	if (argc != 2)
+	{
+		std::fprintf(stderr,
+			"Usage: %s <trace file>\n"
+			"\n"
+			"Replays a semihosting trace against the stand-in and compares the results. SYS_BATCH calls can't be\n"
+			"replayed as the trace doesn't hold their operations, so they and calls on the FDs they opened are\n"
+			"skipped.\n", argv[0]);
+		return exitFailure;
+	}
+
+	TraceHeader header{};
+	std::vector<TraceRecord> records{};
+	if (!readTrace(argv[1], header, records))
+		return exitFailure;
+	if (header.dropped)
+		std::printf("Trace starts %u calls in, earlier calls were overwritten before the dump\n", header.dropped);
+
+	Replayer replayer{};
+	std::map<Syscall, callStats_t> stats{};
+	uint32_t mismatches{0U};
+	for (size_t index{0U}; index < records.size(); ++index)
+	{
+		const auto &record{records[index]};
+		auto &callStats{stats[record.syscall]};
+		++callStats.count;
+		const auto check{checkFor(record.syscall)};
+		if (check == Check::skip)
+		{
+			++callStats.skipped;
+			continue;
+		}
+
+		const auto start{std::chrono::steady_clock::now()};
+		const auto result{replayer.replay(record)};
+		const auto end{std::chrono::steady_clock::now()};
+		if (!result)
+		{
+			++callStats.skipped;
+			continue;
+		}
+		callStats.recordedMicroseconds += (record.ticks * 1e6) / header.tickFrequency;
+		callStats.replayMicroseconds += std::chrono::duration<double, std::micro>{end - start}.count();
+
+		bool matched{true};
+		if (check == Check::exact)
+			matched = *result == record.result;
+		else if (check == Check::success)
+			matched = (*result == -1) == (record.result == -1);
+		// If the firmware asked what went wrong, the stand-in must agree
+		if (matched && *result == -1 && record.error != FileIOErrno::success)
+		{
+			const auto error{static_cast<FileIOErrno>(semihostingStandin(Syscall::lastErrno, nullptr))};
+			matched = error == record.error;
+		}
+		if (!matched)
+		{
+			++callStats.mismatches;
+			++mismatches;
+			std::printf("Call %zu (%s): probe returned %d (errno %d), stand-in returned %d\n", index,
+				syscallName(record.syscall).c_str(), record.result, static_cast<int32_t>(record.error), *result);
+		}
+	}
+
+	std::printf("%-18s %6s %7s %10s %13s %12s\n", "call", "count", "skipped", "mismatches", "probe us/call",
+		"replay us/call");
+	for (const auto &[syscall, callStats] : stats)
+	{
+		const auto replayed{callStats.count - callStats.skipped};
+		std::printf("%-18s %6u %7u %10u %13.2f %12.2f\n", syscallName(syscall).c_str(), callStats.count,
+			callStats.skipped, callStats.mismatches, replayed ? callStats.recordedMicroseconds / replayed : 0.0,
+			replayed ? callStats.replayMicroseconds / replayed : 0.0);
+	}
+	if (const auto batches{stats.find(Syscall::batch)}; batches != stats.end())
+		std::printf("Note: %u SYS_BATCH calls were not replayed, nor were calls on any FDs they opened\n",
+			batches->second.count);
+	std::printf("%s: %u mismatches across %zu calls\n", mismatches ? "Failed" : "Passed", mismatches, records.size());
+	return mismatches ? exitMismatch : exitSuccess;
+}
@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* This file is part of the Black Magic Probe test firmware archive.
+ *
+ * Copyright (C) 2023 Rachel Mant <git@dragonmux.network>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <array>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "syscallTypes.hxx"
+#include "standin.hxx"
+
+using namespace semihosting::types;
+
+/*
+ * Plays the debugger's half of semihosting against the host OS. Parameter blocks are read exactly as a probe
+ * would read them out of target memory, with every pointer now a host pointer. A target word is a uintptr_t here,
+ * except that the single-word blocks (the FD or status the library passes by address) are only ever 32 bits.
+ */
+
+namespace standin
+{
+	static bool batchAdvertised{true};
+	static uint32_t haltCount{0U};
+	static FileIOErrno lastError{FileIOErrno::success};
+
+	void advertiseBatch(const bool advertise) noexcept
+		{ batchAdvertised = advertise; }
+
+	uint32_t halts() noexcept
+		{ return haltCount; }
+
+	void resetHalts() noexcept
+		{ haltCount = 0U; }
+
+	// Linux shares the semihosting errno values, bar the two that differ
+	[[nodiscard]] static FileIOErrno toFileIOErrno(const int error) noexcept
+	{
+		switch (error)
+		{
+			case ENOSYS:
+				return FileIOErrno::syscallInvalid;
+			case ENAMETOOLONG:
+				return FileIOErrno::fileNameTooLong;
+			default:
+				return static_cast<FileIOErrno>(error);
+		}
+	}
+
+	// Record errno as the operation's error if it failed, passing the result through
+	[[nodiscard]] static int32_t check(const int32_t result) noexcept
+	{
+		if (result == -1)
+			lastError = toFileIOErrno(errno);
+		return result;
+	}
+
+	[[nodiscard]] static int32_t fail(const FileIOErrno error) noexcept
+	{
+		lastError = error;
+		return -1;
+	}
+
+	[[nodiscard]] static const uintptr_t *words(const void *const params) noexcept
+		{ return static_cast<const uintptr_t *>(params); }
+
+	[[nodiscard]] static int32_t word32(const void *const params) noexcept
+	{
+		int32_t value{};
+		std::memcpy(&value, params, sizeof(value));
+		return value;
+	}
+
+	[[nodiscard]] static std::string string(const uintptr_t pointer, const uintptr_t length)
+		{ return {reinterpret_cast<const char *>(pointer), length}; }
+
+	// `:semihosting-features` is served from an unlinked temporary file so it reads, seeks and closes like any other
+	[[nodiscard]] static int32_t openFeatures() noexcept
+	{
+		std::array<char, 32> name{"/tmp/semihostingStandinXXXXXX"};
+		const auto fd{mkstemp(name.data())};
+		if (fd == -1)
+			return check(fd);
+		unlink(name.data());
+		// Extended exit and stdout+stderr, as BMD supports, plus the batch extension's byte when it's advertised
+		const std::array<uint8_t, 6> features{{'S', 'H', 'F', 'B', 3U, featureBatch}};
+		const auto length{batchAdvertised ? features.size() : features.size() - featureBatchByte};
+		if (::write(fd, features.data(), length) != static_cast<ssize_t>(length) || lseek(fd, 0, SEEK_SET) != 0)
+		{
+			::close(fd);
+			return fail(FileIOErrno::ioError);
+		}
+		return fd;
+	}
+
+	[[nodiscard]] static int32_t open(const uintptr_t *const params) noexcept
+	{
+		const auto path{string(params[0], params[2])};
+		const auto mode{static_cast<OpenMode>(params[1])};
+		if (path == ":semihosting-features")
+			return openFeatures();
+		// `:tt` is the console - stdin for read modes, stdout for write modes and stderr for append modes
+		if (path == ":tt")
+			return static_cast<int32_t>(params[1] >> 2U);
+
+		// Bit 1 of the mode is "+" (both ways), and the mode groups of 4 are read, write and append
+		const auto plus{(params[1] & 2U) != 0U};
+		int flags{plus ? O_RDWR : O_RDONLY};
+		if (mode >= OpenMode::append)
+			flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+		else if (mode >= OpenMode::write)
+			flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+		return check(::open(path.c_str(), flags, 0644));
+	}
+
+	[[nodiscard]] static int32_t transfer(const uintptr_t *const params, const bool write) noexcept
+	{
+		const auto fd{static_cast<int32_t>(params[0])};
+		auto *const data{reinterpret_cast<uint8_t *>(params[1])};
+		const auto length{params[2]};
+		const auto result
+		{
+			write ? ::write(fd, data, length) : ::read(fd, data, length)
+		};
+		if (result == -1)
+			return check(-1);
+		// Both return the number of bytes *not* transferred
+		return static_cast<int32_t>(length - static_cast<size_t>(result));
+	}
+
+	[[nodiscard]] static int32_t fileLength(const int32_t fd) noexcept
+	{
+		struct stat status{};
+		if (check(fstat(fd, &status)) == -1)
+			return -1;
+		return static_cast<int32_t>(status.st_size);
+	}
+
+	[[nodiscard]] static int32_t readCommandLine(const void *const params) noexcept
+	{
+		auto *const block{const_cast<uintptr_t *>(words(params))};
+		constexpr static std::string_view commandLine{"semihostingStandin"};
+		if (block[1] <= commandLine.size())
+			return fail(FileIOErrno::argumentInvalid);
+		auto *const buffer{reinterpret_cast<char *>(block[0])};
+		std::memcpy(buffer, commandLine.data(), commandLine.size());
+		buffer[commandLine.size()] = '\0';
+		block[1] = commandLine.size();
+		return 0;
+	}
+
+	[[nodiscard]] static uint64_t elapsedNanoseconds() noexcept
+	{
+		static const auto startTime{[]() noexcept
+		{
+			timespec time{};
+			clock_gettime(CLOCK_MONOTONIC, &time);
+			return time;
+		}()};
+		timespec now{};
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return static_cast<uint64_t>(now.tv_sec - startTime.tv_sec) * 1000000000U +
+			static_cast<uint64_t>(now.tv_nsec) - static_cast<uint64_t>(startTime.tv_nsec);
+	}
+
+	[[nodiscard]] static int32_t dispatch(Syscall syscall, const void *params) noexcept;
+
+	// Run a descriptor list the way a debugger implementing Syscall::batch does, all within the one "halt"
+	[[nodiscard]] static int32_t batch(const uintptr_t *const params) noexcept
+	{
+		auto *const operations{reinterpret_cast<BatchOperation *>(params[0])};
+		const auto count{params[1]};
+		for (size_t index{0U}; index < count; ++index)
+		{
+			auto &operation{operations[index]};
+			operation.error = FileIOErrno::success;
+			if (operation.syscall == Syscall::exit || operation.syscall == Syscall::exitExtended ||
+				operation.syscall == Syscall::batch ||
+				(operation.resultFrom >= 0 && static_cast<size_t>(operation.resultFrom) >= index))
+			{
+				operation.result = -1;
+				operation.error = FileIOErrno::argumentInvalid;
+				return static_cast<int32_t>(index + 1U);
+			}
+			if (operation.resultFrom >= 0)
+				operation.params[0] = static_cast<uintptr_t>(operations[operation.resultFrom].result);
+			operation.result = dispatch(operation.syscall, operation.params);
+			if (operation.result == -1)
+			{
+				operation.error = lastError;
+				return static_cast<int32_t>(index + 1U);
+			}
+		}
+		return static_cast<int32_t>(count);
+	}
+
+	static int32_t dispatch(const Syscall syscall, const void *const params) noexcept
+	{
+		switch (syscall)
+		{
+			case Syscall::open:
+				return open(words(params));
+			case Syscall::close:
+			{
+				const auto fd{word32(params)};
+				// Leave the console's streams open, as the library never really owns them
+				return fd <= STDERR_FILENO ? 0 : check(::close(fd));
+			}
+			case Syscall::writeChar:
+				return ::write(STDOUT_FILENO, params, 1U) == 1 ? 0 : check(-1);
+			case Syscall::writeNulStr:
+			{
+				const auto *const string{static_cast<const char *>(params)};
+				const auto length{std::strlen(string)};
+				return ::write(STDOUT_FILENO, string, length) == static_cast<ssize_t>(length) ? 0 : check(-1);
+			}
+			case Syscall::write:
+				return transfer(words(params), true);
+			case Syscall::read:
+				return transfer(words(params), false);
+			case Syscall::readChar:
+				return std::getchar();
+			case Syscall::isError:
+				return word32(params) < 0 ? 1 : 0;
+			case Syscall::isTTY:
+				return isatty(word32(params));
+			case Syscall::seek:
+			{
+				const auto *const block{words(params)};
+				const auto offset{static_cast<off_t>(block[1])};
+				return lseek(static_cast<int32_t>(block[0]), offset, SEEK_SET) == offset ? 0 : check(-1);
+			}
+			case Syscall::fileLength:
+				return fileLength(word32(params));
+			case Syscall::tempName:
+			{
+				const auto *const block{words(params)};
+				auto *const buffer{reinterpret_cast<char *>(block[0])};
+				const auto length{std::snprintf(buffer, block[2], "/tmp/semihosting-%02x.tmp",
+					static_cast<uint8_t>(block[1]))};
+				return length > 0 && static_cast<size_t>(length) < block[2] ? 0 : fail(FileIOErrno::argumentInvalid);
+			}
+			case Syscall::remove:
+			{
+				const auto *const block{words(params)};
+				return check(unlink(string(block[0], block[1]).c_str()));
+			}
+			case Syscall::rename:
+			{
+				const auto *const block{words(params)};
+				return check(std::rename(string(block[0], block[1]).c_str(), string(block[2], block[3]).c_str()));
+			}
+			case Syscall::clock:
+				// Centiseconds since start up
+				return static_cast<int32_t>(elapsedNanoseconds() / 10000000U);
+			case Syscall::time:
+				return static_cast<int32_t>(std::time(nullptr));
+			case Syscall::system:
+			{
+				const auto *const block{words(params)};
+				return std::system(string(block[0], block[1]).c_str());
+			}
+			case Syscall::lastErrno:
+				return static_cast<int32_t>(lastError);
+			case Syscall::readCommandLine:
+				return readCommandLine(params);
+			case Syscall::heapInfo:
+				// There's no target heap or stack to describe, so say so
+				*static_cast<HeapInfoBlock *>(const_cast<void *>(params)) = {};
+				return 0;
+			case Syscall::exit:
+			case Syscall::exitExtended:
+				// The library returns from these so exits can be tested, so only note them
+				std::fprintf(stderr, "Target requested exit\n");
+				return 0;
+			case Syscall::elapsed:
+			{
+				const auto ticks{elapsedNanoseconds()};
+				std::memcpy(const_cast<void *>(params), &ticks, sizeof(ticks));
+				return 0;
+			}
+			case Syscall::tickFrequency:
+				return 1000000000;
+			case Syscall::batch:
+				if (!batchAdvertised)
+					return fail(FileIOErrno::syscallInvalid);
+				return batch(words(params));
+		}
+		return fail(FileIOErrno::syscallInvalid);
+	}
+} // namespace standin
+
+int32_t semihostingStandin(const Syscall syscall, const void *const paramsPtr) noexcept
+{
+	++standin::haltCount;
+	return standin::dispatch(syscall, paramsPtr);
+}